@@ -0,0 +1,318 @@
+/*******************************************
+
+	University of Udine
+
+	Real-time acquisition thread for the
+	Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The thread reads a snapshot of every sensor once per period, the deadlines are absolute
+	  (clock_nanosleep() with TIMER_ABSTIME on CLOCK_MONOTONIC) so the period does not drift with
+	  the SPI and consumer time
+	- Optional SCHED_FIFO priority (memory is locked too) and pinning to a CPU
+	- A cycle ending after the next deadline is an overrun: the missed periods are skipped and
+	  counted, the following deadlines stay on the original grid
+	- The jitter is the wake up latency from the deadline
+	- The samples are published without blocking: the latest sample of each sensor is kept under a
+	  sequence lock (AcquisitionLatest()) and the optional publish callback must not block (e.g. a
+	  ring push)
+	- Every sample carries the multi-turn position, velocity and acceleration of its sensor
+	  (estimator.c), updated in the thread right after the reading
+	- AcquisitionSetRate() applies an output rate profile (rate.c, RateProfile() for the period of
+	  the thread) to a sensor: ORATE written to the sensor and the host average of the readings
+	  done by the thread. With a host average the angle of the sample is the mean of the last
+	  readings (unwrapped across 0/360 Degrees, not rounded to a count), angleWord stays the raw
+	  reading and feeds the estimator (which filters it on its own)
+	- While the thread runs the sensors must not be accessed by other threads (the bus is not shared)
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+#include "angle.h"
+#include "estimator.h"
+#include "rate.h"
+#include "acquisition.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static void addTime(struct timespec *t, uint64_t ns)
+{
+	ns += t->tv_nsec;
+	t->tv_sec += ns / 1000000000ULL;
+	t->tv_nsec = ns % 1000000000ULL;
+}
+
+static uint64_t toNs(const struct timespec *t)
+{
+	return (uint64_t)t->tv_sec * 1000000000ULL + (uint64_t)t->tv_nsec;
+}
+
+uint64_t AcquisitionTime(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return toNs(&t);
+}
+
+static void publishLatest(A1335latest *latest, const A1335sample *sample)
+{
+	/*Odd sequence while the sample is written*/
+	atomic_fetch_add_explicit(&latest->seq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	latest->sample = *sample;
+	atomic_fetch_add_explicit(&latest->seq, 1, memory_order_release);
+}
+
+static void updateStats(A1335acquisition *acq, int64_t jitter, int64_t cycle, uint64_t missed)
+{
+	A1335acquisitionStats *stats = &acq->stats;
+	double n;
+
+	atomic_fetch_add_explicit(&acq->statsSeq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	if((stats->cycles == 0) || (jitter < stats->jitterMin))
+		stats->jitterMin = jitter;
+	if((stats->cycles == 0) || (jitter > stats->jitterMax))
+		stats->jitterMax = jitter;
+	if(cycle > stats->cycleMax)
+		stats->cycleMax = cycle;
+
+	if(missed > 0)
+	{
+		stats->overruns++;
+		stats->missed += missed;
+	}
+
+	stats->cycles++;
+	acq->jitterSum += (double)jitter;
+	acq->jitterSumSq += (double)jitter * (double)jitter;
+
+	n = (double)stats->cycles;
+	stats->jitterMean = acq->jitterSum / n;
+	stats->jitterStd = sqrt(fmax(acq->jitterSumSq / n - stats->jitterMean * stats->jitterMean, 0.0));
+
+	atomic_fetch_add_explicit(&acq->statsSeq, 1, memory_order_release);
+}
+
+static void *acquisitionThread(void *arg)
+{
+	A1335acquisition *acq = (A1335acquisition *)arg;
+	uint8_t buffer[BUFFER_SIZE];
+	uint64_t sequence = 0, deadline, now, missed;
+	struct timespec next;
+	A1335sample sample;
+	double average;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while(atomic_load_explicit(&acq->running, memory_order_relaxed))
+	{
+		/*Sleep until the absolute deadline*/
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+
+		deadline = toNs(&next);
+		now = AcquisitionTime();
+
+		for(i = 0; i < acq->n; i++)
+		{
+			sample.cs = acq->cs[i];
+			sample.sequence = sequence;
+			sample.timestamp = AcquisitionTime();
+
+			/*Cleared: a failed transfer writes nothing (no values of the previous sensor)*/
+			memset(&sample.snapshot, 0, sizeof(A1335snapshot));
+			sample.error = getSnapshot(acq->cs[i], buffer, &sample.snapshot);
+
+			/*Host average of the angle (the mean of the readings so far while the window fills)*/
+			if((sample.error == NOERROR) && (acq->averager[i].n > 1))
+			{
+				AveragerAdd(&acq->averager[i], sample.snapshot.angleWord & 0x0FFF, &average);
+				sample.snapshot.angle = (float)average;
+			}
+
+			/*Estimates ready with the sample*/
+			if(sample.error == ERROR)
+				sample.estimate = acq->estimator[i].estimate;
+			else
+				EstimatorUpdate(&acq->estimator[i], sample.snapshot.angleWord, sample.timestamp, &sample.estimate);
+
+			publishLatest(&acq->latest[i], &sample);
+
+			if(acq->publish != NULL)
+				acq->publish(&sample, acq->publishCtx);
+		}
+		sequence++;
+
+		/*Next deadline, skipping the periods already over*/
+		addTime(&next, acq->period);
+		missed = 0;
+		while(toNs(&next) <= AcquisitionTime())
+		{
+			addTime(&next, acq->period);
+			missed++;
+		}
+
+		updateStats(acq, (int64_t)(now - deadline), (int64_t)(AcquisitionTime() - now), missed);
+	}
+
+	return NULL;
+}
+
+int AcquisitionInit(A1335acquisition *acq, const int cs[], int n, uint64_t period)
+{
+	int i;
+
+	if((n <= 0) || (n > ACQUISITION_MAX_SENSORS) || (period == 0))
+		return ERROR;
+
+	memset(acq, 0, sizeof(A1335acquisition));
+
+	for(i = 0; i < n; i++)
+	{
+		acq->cs[i] = cs[i];
+		EstimatorInit(&acq->estimator[i], ESTIMATOR_ALPHA, ESTIMATOR_BETA, ESTIMATOR_GAMMA);
+		AveragerInit(&acq->averager[i], 1);
+	}
+
+	acq->n = n;
+	acq->period = period;
+	acq->priority = 0;
+	acq->cpu = -1;
+	acq->publish = NULL;
+	acq->publishCtx = NULL;
+
+	return NOERROR;
+}
+
+int AcquisitionSetRate(A1335acquisition *acq, int i, const A1335rate *rate)
+{
+	uint8_t buffer[BUFFER_SIZE];
+
+	/*The thread owns the bus while it runs*/
+	if((i < 0) || (i >= acq->n) || atomic_load(&acq->running))
+		return ERROR;
+
+	if(RateApply(acq->cs[i], buffer, rate) == ERROR)
+		return ERROR;
+
+	AveragerInit(&acq->averager[i], rate->average);
+
+	return NOERROR;
+}
+
+int AcquisitionStart(A1335acquisition *acq)
+{
+	pthread_attr_t attr;
+	struct sched_param param;
+	cpu_set_t cpus;
+	int result;
+
+	pthread_attr_init(&attr);
+
+	if(acq->priority > 0)
+	{
+		/*Avoid page faults in the acquisition loop*/
+		mlockall(MCL_CURRENT | MCL_FUTURE);
+
+		param.sched_priority = acq->priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+
+	if(acq->cpu >= 0)
+	{
+		CPU_ZERO(&cpus);
+		CPU_SET(acq->cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+
+	atomic_store(&acq->running, 1);
+	result = pthread_create(&acq->thread, &attr, acquisitionThread, acq);
+	pthread_attr_destroy(&attr);
+
+	if(result != 0)
+	{
+		atomic_store(&acq->running, 0);
+		return ERROR;
+	}
+
+	return NOERROR;
+}
+
+void AcquisitionStop(A1335acquisition *acq)
+{
+	if(atomic_exchange(&acq->running, 0))
+		pthread_join(acq->thread, NULL);
+}
+
+int AcquisitionLatest(A1335acquisition *acq, int i, A1335sample *sample)
+{
+	A1335latest *latest;
+	unsigned int s1, s2;
+
+	if((i < 0) || (i >= acq->n))
+		return ERROR;
+
+	latest = &acq->latest[i];
+
+	do
+	{
+		s1 = atomic_load_explicit(&latest->seq, memory_order_acquire);
+		*sample = latest->sample;
+		atomic_thread_fence(memory_order_acquire);
+		s2 = atomic_load_explicit(&latest->seq, memory_order_relaxed);
+	} while((s1 != s2) || (s1 & 1));
+
+	/*No sample yet*/
+	if(s1 == 0)
+		return ERROR;
+
+	return NOERROR;
+}
+
+void AcquisitionGetStats(A1335acquisition *acq, A1335acquisitionStats *stats)
+{
+	unsigned int s1, s2;
+
+	do
+	{
+		s1 = atomic_load_explicit(&acq->statsSeq, memory_order_acquire);
+		*stats = acq->stats;
+		atomic_thread_fence(memory_order_acquire);
+		s2 = atomic_load_explicit(&acq->statsSeq, memory_order_relaxed);
+	} while((s1 != s2) || (s1 & 1));
+}
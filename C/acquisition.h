@@ -0,0 +1,85 @@
+#ifndef ACQUISITION_H__
+#define ACQUISITION_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sample.h"
+#include "rate.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define ACQUISITION_MAX_SENSORS 16		//Max number of sensors read by a thread
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Called by the acquisition thread for every sample, must not block*/
+typedef void (*AcquisitionPublish)(const A1335sample *sample, void *ctx);
+
+/*Period statistics*/
+typedef struct
+{
+	uint64_t cycles;			//Number of cycles
+	uint64_t overruns;			//Cycles that ended after the next deadline
+	uint64_t missed;			//Periods skipped because of overruns
+	int64_t jitterMin;			//Min wake up latency from the deadline (in ns)
+	int64_t jitterMax;			//Max wake up latency from the deadline (in ns)
+	double jitterMean;			//Mean wake up latency (in ns)
+	double jitterStd;			//Standard deviation of the wake up latency (in ns)
+	int64_t cycleMax;			//Max duration of a cycle (in ns)
+} A1335acquisitionStats;
+
+/*Latest sample of a sensor (sequence lock: odd while written)*/
+typedef struct
+{
+	atomic_uint seq;
+	A1335sample sample;
+} A1335latest;
+
+typedef struct
+{
+	/*Configuration (set before AcquisitionStart())*/
+	int cs[ACQUISITION_MAX_SENSORS];	//Chip selects of the sensors
+	int n;								//Number of sensors
+	uint64_t period;					//Period (in ns)
+	int priority;						//SCHED_FIFO priority (0 = default scheduling)
+	int cpu;							//CPU the thread is pinned to (-1 = no pinning)
+	AcquisitionPublish publish;			//Optional consumer of every sample
+	void *publishCtx;
+	A1335estimator estimator[ACQUISITION_MAX_SENSORS];	//Filter of each sensor (default gains, EstimatorInit() to change them)
+	A1335averager averager[ACQUISITION_MAX_SENSORS];	//Host average of the angle of each sensor (none by default, AcquisitionSetRate())
+
+	/*State*/
+	pthread_t thread;
+	atomic_int running;
+	A1335latest latest[ACQUISITION_MAX_SENSORS];
+	atomic_uint statsSeq;
+	A1335acquisitionStats stats;
+	double jitterSum;
+	double jitterSumSq;
+} A1335acquisition;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int AcquisitionInit(A1335acquisition *acq, const int cs[], int n, uint64_t period);
+int AcquisitionStart(A1335acquisition *acq);
+void AcquisitionStop(A1335acquisition *acq);
+int AcquisitionSetRate(A1335acquisition *acq, int i, const A1335rate *rate);
+int AcquisitionLatest(A1335acquisition *acq, int i, A1335sample *sample);
+void AcquisitionGetStats(A1335acquisition *acq, A1335acquisitionStats *stats);
+uint64_t AcquisitionTime(void);
+
+#endif
@@ -14,12 +14,16 @@
 
 	NOTE:
 
-	- CRC diabled by default
+	- CRC disabled by default, SPIsetCRC() turns on the CRC framing of a chip select once the sensor is configured for it (see spi.c)
 	- Self Test enabled by default
 	- To write a full 16 bit serial register, two Write commands are required one for even and one for odd byte addresses
 	- To write a only a single byte serial register, one Write commands are required specifying the address
 	- To read a full 16 bit serial register, two equal Read commands are required specifying even byte address
 	- To read only a single byte serial register, two equal Read commands are required specifying odd byte address, the 8 MSB will be 0
+	- The frames of one operation are queued and submitted to the bus with a single transfer (see spi.c)
+	- The SRAM configuration goes through SRAMread()/SRAMwrite(), served by the shadow copy if one is attached (see shadow.c)
+	- Extended accesses, angles and snapshots are timed and counted per device (see metrics.c)
+	- getTemp() and getField() return NAN if the transfer fails (bus error or wrong CRC)
 
 *******************************************/
 
@@ -34,9 +38,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <unistd.h>
 #include "angle.h"
+#include "spi.h"
+#include "shadow.h"
+#include "metrics.h"
 
 /*******************************************
 
@@ -50,29 +58,46 @@ int setBuffer(uint8_t buffer[], uint8_t rw, uint8_t reg, uint8_t data)
 	buffer[1] = data;	//[7:0]
 }
 
-int ExtendedWrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value)
+int ReadRegister(int cs, uint8_t buffer[], uint8_t reg)
 {
+	SPIqueue queue;
+
+	/*Two equal Read commands in a single transfer, the second response holds the register*/
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, R, reg, 0x00);
+	SPIqueueFrame(&queue, R, reg, 0x00);
+
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
+
+	SPIqueueResponse(&queue, 1, buffer);
+
+	return NOERROR;
+}
+
+static int extendedWrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value)
+{
+	SPIqueue queue;
 	uint32_t timeout;
 
+	SPIqueueInit(&queue);
+
 	/*Write into EWA (Extended Write Address) register at addresses 0x02:0x03*/
-	setBuffer(buffer, W, 0x02, (uint8_t)((address >> 8) & 0x00FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x03, (uint8_t)(address & 0x00FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueFrame(&queue, W, 0x02, (uint8_t)((address >> 8) & 0x00FF));
+	SPIqueueFrame(&queue, W, 0x03, (uint8_t)(address & 0x00FF));
 
 	/*Write into EWD (Extended Write Data) register at addresses 0x04:0x07*/
-	setBuffer(buffer, W, 0x04, (uint8_t)((value >> 24) & 0x000000FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x05, (uint8_t)((value >> 16) & 0x000000FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x06, (uint8_t)((value >> 8) & 0x000000FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x07, (uint8_t)(value) & 0x000000FF);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueFrame(&queue, W, 0x04, (uint8_t)((value >> 24) & 0x000000FF));
+	SPIqueueFrame(&queue, W, 0x05, (uint8_t)((value >> 16) & 0x000000FF));
+	SPIqueueFrame(&queue, W, 0x06, (uint8_t)((value >> 8) & 0x000000FF));
+	SPIqueueFrame(&queue, W, 0x07, (uint8_t)(value) & 0x000000FF);
 
 	/*Write EXW (Extended Execute Write = Start writing process) into EWCS (Extended Write Control and Status) register at address 0x08*/
-	setBuffer(buffer, W, 0x08, 0x80);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueFrame(&queue, W, 0x08, 0x80);
+
+	/*Submit the 7 frames in a single transfer*/
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
 
 	/*If writing, program parameters in the EEPROM (addressing range (0x306 – 0x319)) send the programming pulses*/
 	if((address >= 0x306) && (address <= 0x319))
@@ -96,36 +121,56 @@ int ExtendedWrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value)
 	do
     {
 		/*Read WDN (Write Done to Extended Address) into EWCS (Extended Write Control and Status) register at address 0x08*/
-		setBuffer(buffer, R, 0x08, 0x00);
-		wiringPiSPIDataRW(cs, buffer, 2);
-		setBuffer(buffer, R, 0x08, 0x00);
-		wiringPiSPIDataRW(cs, buffer, 2);
+		if(ReadRegister(cs, buffer, 0x08) == ERROR)
+			return ERROR;
+
+		MetricsCount(cs, METRIC_POLLS, 1);
+		if((buffer[1] & 0x01) != 0x01)
+			MetricsCount(cs, METRIC_RETRIES, 1);
 
 		/*if write operation takes more than 100 us return a TIMEOUTError*/
 		if (timeout < millis())
+		{
+			MetricsCount(cs, METRIC_TIMEOUTS, 1);
            	return ERROR;
+		}
 		
 	} while((buffer[1] & 0x01) != 0x01);
 
 	return NOERROR;
 }
 
-int ExtendedRead(int cs, uint8_t buffer[], uint16_t address, uint32_t *value)
+int ExtendedWrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value)
+{
+	uint64_t start = MetricsTime();
+	int result;
+
+	result = extendedWrite(cs, buffer, address, value);
+	MetricsRecord(cs, METRIC_EXTENDED_WRITE, start);
+
+	return result;
+}
+
+static int extendedRead(int cs, uint8_t buffer[], uint16_t address, uint32_t *value)
 {
+	SPIqueue queue;
 	uint32_t timeout;
 	
 	/*Clear value*/
 	*value = 0x00000000;
 
+	SPIqueueInit(&queue);
+
 	/*Write into ERA (Extended Read Address) register at address 0x0A:0x0B*/
-	setBuffer(buffer, W, 0x0A, (uint8_t)((address >> 8) & 0x00FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x0B, (uint8_t)(address & 0x00FF));
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueFrame(&queue, W, 0x0A, (uint8_t)((address >> 8) & 0x00FF));
+	SPIqueueFrame(&queue, W, 0x0B, (uint8_t)(address & 0x00FF));
 	
 	/*Write EXR (Extended Execute Read = Start reading process) into ERCS (Extended Read Control and Status) register at address 0x0C*/
-	setBuffer(buffer, W, 0x0C, 0x80);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueFrame(&queue, W, 0x0C, 0x80);
+
+	/*Submit the 3 frames in a single transfer*/
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
 	
 	timeout = millis() + 100;
 	
@@ -133,44 +178,59 @@ int ExtendedRead(int cs, uint8_t buffer[], uint16_t address, uint32_t *value)
 	do
 	{
 		/*Read RDN (Read Done to Extended Address) into ERCS (Extended Read Control and Status) register at address 0x0C*/
-      		setBuffer(buffer, R, 0x0C, 0x00);
-		wiringPiSPIDataRW(cs, buffer, 2);
-		setBuffer(buffer, R, 0x0C, 0x00);
-		wiringPiSPIDataRW(cs, buffer, 2);
+		if(ReadRegister(cs, buffer, 0x0C) == ERROR)
+			return ERROR;
+
+		MetricsCount(cs, METRIC_POLLS, 1);
+		if((buffer[1] & 0x01) != 0x01)
+			MetricsCount(cs, METRIC_RETRIES, 1);
 		
 		/*if read operation takes more than 100 us return a TIMEOUTError*/
         	if (timeout < millis())
+		{
+			MetricsCount(cs, METRIC_TIMEOUTS, 1);
             		return ERROR;
+		}
 
     	} while((buffer[1] & 0x01) != 0x01);
 	
-	/*Read the ERD (Extended Read Data) register at address 0x0E:0x11*/
-	setBuffer(buffer, R, 0x0E, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x0E, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	
+	/*Read the ERD (Extended Read Data) register at address 0x0E:0x11 in a single transfer*/
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, R, 0x0E, 0x00);
+	SPIqueueFrame(&queue, R, 0x0E, 0x00);
+	SPIqueueFrame(&queue, R, 0x10, 0x00);
+	SPIqueueFrame(&queue, R, 0x10, 0x00);
+
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
+
+	SPIqueueResponse(&queue, 1, buffer);
 	*value = ((uint32_t)buffer[0] << 24) + ((uint32_t)buffer[1] << 16);
 	
-	setBuffer(buffer, R, 0x10, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x10, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	
+	SPIqueueResponse(&queue, 3, buffer);
 	*value = *value + ((uint32_t)buffer[0] << 8) + ((uint32_t)buffer[1]);
 	
 	return NOERROR;
 }
 
+int ExtendedRead(int cs, uint8_t buffer[], uint16_t address, uint32_t *value)
+{
+	uint64_t start = MetricsTime();
+	int result;
+
+	result = extendedRead(cs, buffer, address, value);
+	MetricsRecord(cs, METRIC_EXTENDED_READ, start);
+
+	return result;
+}
+
 int checkSelfTest(int cs, uint8_t buffer[])
 {
 	uint32_t data = 0x00000000;
 
 	/*Read the XERR register at address 0x26:0x27*/
-	setBuffer(buffer, R, 0x26, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x26, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	if(ReadRegister(cs, buffer, 0x26) == ERROR)
+		return ERROR;
 
 	/*Check the ST bit*/
 	if((buffer[1] & 0x01) == 0x00)
@@ -179,72 +239,99 @@ int checkSelfTest(int cs, uint8_t buffer[])
 		return ERROR;
 }
 
+int checkNewAngle(int cs, uint8_t buffer[])
+{
+	uint16_t word, count;
+
+	/*Read the angle register at address 0x20:0x21*/
+	if(ReadRegister(cs, buffer, 0x20) == ERROR)
+		return ERROR;
+
+	word = ((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1];
+
+	/*Check the NF bit and the parity*/
+	if(((word & ANGLE_NF) == ANGLE_NF) && (decodeAngleCount(word, &count) == NOERROR))
+		return NOERROR;
+	else
+		return ERROR;
+}
+
 int SoftReset(int cs, uint8_t buffer[])
 {
+	SPIqueue queue;
+
 	/* Write soft reset command into CTRL (Control) register at address 0x1E:0x1F*/
-	setBuffer(buffer, W, 0x1F, 0xB9);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x1E, 0x16);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, W, 0x1F, 0xB9);
+	SPIqueueFrame(&queue, W, 0x1E, 0x16);
 
-	return NOERROR;
+	/*The SRAM is reloaded from the EEPROM*/
+	ShadowInvalidate(cs);
+
+	return SPIsubmit(cs, &queue);
 }
 
 int HardReset(int cs, uint8_t buffer[])
 {
+	SPIqueue queue;
+
 	/* Write soft reset command into CTRL (Control) register at address 0x1E:0x1F*/
-	setBuffer(buffer, W, 0x1F, 0xB9);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x1E, 0x32);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, W, 0x1F, 0xB9);
+	SPIqueueFrame(&queue, W, 0x1E, 0x32);
 
-	return NOERROR;
+	/*The SRAM is reloaded from the EEPROM*/
+	ShadowInvalidate(cs);
+
+	return SPIsubmit(cs, &queue);
+}
+
+int RequestProcessorState(int cs, uint8_t buffer[], uint8_t state)
+{
+	SPIqueue queue;
+
+	/*Write the idle (0x80) or run (0xC0) state command into CTRL (Control) register at address 0x1E:0x1F*/
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, W, 0x1E, (state == STATE_IDLE) ? 0x80 : 0xC0);
+	SPIqueueFrame(&queue, W, 0x1F, 0x46);
+
+	return SPIsubmit(cs, &queue);
+}
+
+int CheckProcessorState(int cs, uint8_t buffer[], uint8_t state)
+{
+	/*Check the processor state - Read the status register at address 0x22:0x23*/
+	if(ReadRegister(cs, buffer, 0x22) == ERROR)
+		return ERROR;
+
+	if((buffer[1] & 0xFF) != state)
+		return ERROR;
+	else
+		return NOERROR;
 }
 
 int SetProcessorStateToIdle(int cs, uint8_t buffer[])
 { 
-    /*Write the idle state command into CTRL (Control) register at address 0x1E:0x1F*/
-	setBuffer(buffer, W, 0x1E, 0x80);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x1F, 0x46);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	if(RequestProcessorState(cs, buffer, STATE_IDLE) == ERROR)
+		return ERROR;
     
 	/*Wait 1 ms*/
 	delay(1);
 
-	/*Check if the processor is in the idle state - Read the status register at address 0x22:0x23*/
-	setBuffer(buffer, R, 0x22, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x22, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-
-	if((buffer[1] & 0xFF) != 0x10)
-		return ERROR;
-	else
-		return NOERROR;
+	/*Check if the processor is in the idle state*/
+	return CheckProcessorState(cs, buffer, STATE_IDLE);
 }
 
 int SetProcessorStateToRun(int cs, uint8_t buffer[])
 {
-	/*Write the run state command into CTRL (Control) register at address 0x1E:0x1F*/
-	setBuffer(buffer, W, 0x1E, 0xC0);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, W, 0x1F, 0x46);
-	wiringPiSPIDataRW(cs, buffer, 2);
+	if(RequestProcessorState(cs, buffer, STATE_RUN) == ERROR)
+		return ERROR;
 	
     /*Wait 1 ms*/
 	delay(1);
     
-	/*Check if the processor is in the run state - Read the status register at address 0x22:0x23*/
-	setBuffer(buffer, R, 0x22, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x22, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-
-	if((buffer[1] & 0xFF) != 0x11)
-		return ERROR;
-	else
-		return NOERROR;
+	/*Check if the processor is in the run state*/
+	return CheckProcessorState(cs, buffer, STATE_RUN);
 }
 
 int UnlockDevice(int cs, uint8_t buffer[])
@@ -284,12 +371,7 @@ int EEPROMSetup(int cs, uint8_t buffer[])
 
 int SRAMsetup(int cs, uint8_t buffer[])
 {	
-	uint32_t data;
-	uint16_t addrContent;
-	uint16_t MaxAngle;
-	uint16_t MinAngle;
-	uint16_t GainOffset;
-	float angle;
+	uint32_t flags;
 	
 	/*
 		Write SRAM configuration
@@ -309,13 +391,65 @@ int SRAMsetup(int cs, uint8_t buffer[])
 	if(SetProcessorStateToIdle(cs, buffer) == ERROR)
 		return ERROR;
 
-	/*Set the ORATE (Output RATE to 128 sample -> 4ms refresh time) by writing 0x00000007 to extended address 0xFFD0*/
-	if(ExtendedWrite(cs, buffer, 0xFFD0, 0x00000007) == ERROR)
+	if(SRAMsetOutputRate(cs, buffer) == ERROR)
 		return ERROR;
 
 	if(SetProcessorStateToRun(cs, buffer) == ERROR)
 		return ERROR;
 
+	if(SRAMwriteConfig(cs, buffer, &flags) == ERROR)
+		return ERROR;
+	
+	/*Get the current angle after 100ms and set it as zero*/
+	delay(100);
+	if(SRAMsetZeroOffset(cs, buffer, flags) == ERROR)
+		return ERROR;
+	
+	/*Get the current angle after 100ms and set it as PreLinearization 0 Offset*/
+	delay(100);
+	if(SRAMsetPreLinearizationOffset(cs, buffer) == ERROR)
+		return ERROR;
+
+	return NOERROR;
+}
+
+int SRAMsetOutputRate(int cs, uint8_t buffer[])
+{
+	/*Set the ORATE (Output RATE to 128 sample -> 4ms refresh time with the default ORATE 7)*/
+	return WriteOutputRate(cs, buffer, ORATE);
+}
+
+int WriteOutputRate(int cs, uint8_t buffer[], uint8_t orate)
+{
+	if(orate > ORATE_MAX)
+		return ERROR;
+
+	/*Write ORATE (2^orate samples averaged) to extended address 0xFFD0 (processor in idle state)*/
+	if(ExtendedWrite(cs, buffer, 0xFFD0, (uint32_t)orate) == ERROR)
+		return ERROR;
+
+	return NOERROR;
+}
+
+int SetOutputRate(int cs, uint8_t buffer[], uint8_t orate)
+{
+	/*Change the output rate of a running sensor, the rest of the configuration is kept*/
+	if(SetProcessorStateToIdle(cs, buffer) == ERROR)
+		return ERROR;
+
+	if(WriteOutputRate(cs, buffer, orate) == ERROR)
+		return ERROR;
+
+	return SetProcessorStateToRun(cs, buffer);
+}
+
+int SRAMwriteConfig(int cs, uint8_t buffer[], uint32_t *flags)
+{
+	uint32_t data;
+	uint16_t MaxAngle;
+	uint16_t MinAngle;
+	uint16_t GainOffset;
+
 	/*
 		Enable by writing SRAM at address 0x06: 
 			- Short Stroke Application
@@ -325,7 +459,7 @@ int SRAMsetup(int cs, uint8_t buffer[])
  	*/
 
 	data = 0x0FFFFFFF & (((uint32_t)LINEARIZATION << 26) + ((uint32_t)SHORTSTROKE << 24) + ((uint32_t)DIRECTION << 21) + ((uint32_t)ENCODER << 20));
-	if(ExtendedWrite(cs, buffer, 0x0006, data)== ERROR)
+	if(SRAMwrite(cs, buffer, 0x0006, data)== ERROR)
 		return ERROR;
 
 	/*
@@ -341,65 +475,86 @@ int SRAMsetup(int cs, uint8_t buffer[])
 		MaxAngle = MAXANGLE * 65536 / 360;
 		MinAngle = MINANGLE * 65536 / 360;
 		data = (uint32_t)MaxAngle << 16 + (uint32_t)MinAngle;
-		if(ExtendedWrite(cs, buffer, 0x0001, data)== ERROR)
+		if(SRAMwrite(cs, buffer, 0x0001, data)== ERROR)
 			return ERROR;
-		if(ExtendedWrite(cs, buffer, 0x0002, data)== ERROR)
+		if(SRAMwrite(cs, buffer, 0x0002, data)== ERROR)
 			return ERROR;
 	}
 	
 	GainOffset = GAINOFFSET * 65536/360;
 	data = ((uint32_t)GAINOFFSET << 16) + (uint32_t)(((uint16_t)GAIN << 8) + (uint16_t)(100*(float)(GAIN - (uint16_t)GAIN)));
 	
-	if(ExtendedWrite(cs, buffer, 0x0003, data)== ERROR)
+	if(SRAMwrite(cs, buffer, 0x0003, data)== ERROR)
 		return ERROR;
 
 	/*Bypass the Segmented Linearization Algorithm*/
 	/*Read the SRAM at address 0x06*/
-	if(ExtendedRead(cs, buffer, 0x0006, &data) == ERROR)
+	if(SRAMread(cs, buffer, 0x0006, &data) == ERROR)
 		return ERROR;
 
 	/*Set SB to 1 (Prevent Segmented Linearization)*/
 	data += 0x02000000;
 
 	/*Write the SRAM at address 0x06*/
-	if(ExtendedWrite(cs, buffer, 0x0006, data) == ERROR)
+	if(SRAMwrite(cs, buffer, 0x0006, data) == ERROR)
 		return ERROR;
 
 	/*Read the SRAM at address 0x06*/
-	if(ExtendedRead(cs, buffer, 0x0006, &data) == ERROR)
+	if(SRAMread(cs, buffer, 0x0006, &data) == ERROR)
 		return ERROR;
 
 	/*Set angle offset to 0 (2 bytes flags, 2 bytes angle offset) preserving the flag*/
 	data &= 0xFFFF0000;
 	
-	if(ExtendedWrite(cs, buffer, 0x0006, data)== ERROR)
+	if(SRAMwrite(cs, buffer, 0x0006, data)== ERROR)
+		return ERROR;
+
+	/*Write back the configuration before reading the angle*/
+	if(ShadowFlush(cs, buffer) == ERROR)
+		return ERROR;
+
+	*flags = data;
+
+	return NOERROR;
+}
+
+int SRAMsetZeroOffset(int cs, uint8_t buffer[], uint32_t flags)
+{
+	uint32_t data;
+	uint16_t addrContent;
+
+	/*Get the current angle (in angle resolution units) reading the primary register 0x20:0x21*/
+	if(ReadRegister(cs, buffer, 0x20) == ERROR)
 		return ERROR;
-	
-	/*Get the current angle (in angle resolution units) reading the primary register 0x20:0x21 after 100ms*/
-	delay(100);
-	setBuffer(buffer, R, 0x20, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x20, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
 
 	/*Set actual angle as zero (ATTENTION: SRAM 0x06 register bits are [15:4] angle and [3:0] zero)*/ 
 	addrContent = ((uint16_t)(buffer[0] & 0x0F) << 12) + ((uint16_t)buffer[1] << 4);
-	data = (data & 0xFFFF0000) | ((uint32_t)addrContent & 0x0000FFF0);
+	data = (flags & 0xFFFF0000) | ((uint32_t)addrContent & 0x0000FFF0);
 	
 	/*Write the SRAM at address 0x06*/
-	if(ExtendedWrite(cs, buffer, 0x0006, data) == ERROR)
+	if(SRAMwrite(cs, buffer, 0x0006, data) == ERROR)
 		return ERROR;
-	
-	/*Get the current angle (in degrees) after 100ms*/
-	delay(100);
-	angle = getAngle(cs, buffer);
+
+	return ShadowFlush(cs, buffer);
+}
+
+int SRAMsetPreLinearizationOffset(int cs, uint8_t buffer[])
+{
+	uint32_t data;
+	uint16_t count;
+	float angle;
+
+	/*Get the current angle (in degrees), a failed reading must not become the offset*/
+	if(getAngleCount(cs, buffer, &count) != NOERROR)
+		return ERROR;
+	angle = (float)(count * 360.0 / 4096.0);
 	
 	/*Set the PreLinearization 0 Offset by writing SRAM at address 0x13*/
 	data = (uint32_t)((65536 / 365) * angle) << 16;
-	if(ExtendedWrite(cs, buffer, 0x0013, data)== ERROR)
+	if(SRAMwrite(cs, buffer, 0x0013, data)== ERROR)
 		return ERROR;
 
-	return NOERROR;
+	return ShadowFlush(cs, buffer);
 }
 
 int SetSLCoefficients(int cs, uint8_t buffer[], float angle, int i)
@@ -411,7 +566,7 @@ int SetSLCoefficients(int cs, uint8_t buffer[], float angle, int i)
 	address = 0x000C + (uint16_t)((i-1) / 2);
 
 	/*Read the SRAM at address*/
-	if(ExtendedRead(cs, buffer, address, &data) == ERROR)
+	if(SRAMread(cs, buffer, address, &data) == ERROR)
 		return ERROR;
 
 	if((i % 2) != 0)
@@ -428,85 +583,220 @@ int SetSLCoefficients(int cs, uint8_t buffer[], float angle, int i)
 	}
 	
 	/*Write the SRAM at address*/
-	if(ExtendedWrite(cs, buffer, address, data)== ERROR)
+	if(SRAMwrite(cs, buffer, address, data)== ERROR)
 		return ERROR;
 
 	/*Disable the Segmented Linearization algorithm Bypass*/
 	if(i == 15)
 	{
 		/*Read the SRAM at address 0x06*/
-		if(ExtendedRead(cs, buffer, 0x0006, &data) == ERROR)
+		if(SRAMread(cs, buffer, 0x0006, &data) == ERROR)
 			return ERROR;
 
 		/*Set SB to 0 (Allow Segmented Linearization)*/
 		data &= 0xFDFFFFFF;
 
 		/*Write the SRAM at address 0x06*/
-		if(ExtendedWrite(cs, buffer, 0x0006, data) == ERROR)
+		if(SRAMwrite(cs, buffer, 0x0006, data) == ERROR)
+			return ERROR;
+
+		/*Write back the coefficients (each word once) and the bypass*/
+		if(ShadowFlush(cs, buffer) == ERROR)
 			return ERROR;
 	}
 	return NOERROR;
 }
 
-float getAngle(int cs, uint8_t buffer[])
-
+int SetSLCoefficientsBulk(int cs, uint8_t buffer[], float angle[])
 {
-	float angle;
-	uint16_t input, cnt;
-	int i;
+	uint32_t data[SL_WORDS];
+	uint32_t flags;
+	int i, k;
 
-	/*Get the current angle reading the primary register 0x20:0x21*/
-	setBuffer(buffer, R, 0x20, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x20, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	
-	input = ((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1];
-	cnt = 0x0000;	
+	/*The words are fully overwritten but the last one, holding the coefficient 15 and the PreLinearization 0 Offset*/
+	for(k = 0; k < SL_WORDS - 1; k++)
+		data[k] = 0x00000000;
+
+	if(SRAMread(cs, buffer, 0x000C + SL_WORDS - 1, &data[SL_WORDS - 1]) == ERROR)
+		return ERROR;
+
+	/*Read the SRAM at address 0x06*/
+	if(SRAMread(cs, buffer, 0x0006, &flags) == ERROR)
+		return ERROR;
 
-	/*Count up the number of lsb in the input*/
-	for(i = 0; i < 16; i++)
+	/*Pack the coefficients: odd coefficient i in [15:0] and even coefficient i + 1 in [31:16] of address 0x000C + (i-1)/2*/
+	for(i = 1; i <= SL_COEFFICIENTS; i++)
 	{
-		if((input & 0x0001) == 0x0001)
-			cnt++;
-		
-		input >>= 1;
+		k = (i - 1) / 2;
+
+		if((i % 2) != 0)
+		{
+			/*Odd coefficient*/
+			data[k] &= 0xFFFF0000;
+			data[k] += (uint32_t)((65536 / 365) * angle[i - 1]);
+		}
+		else
+		{
+			/*Even coefficient*/
+			data[k] &= 0x0000FFFF;
+			data[k] += ((uint32_t)((65536 / 365) * angle[i - 1]) << 16) & 0xFFFF0000;
+		}
 	}
 
-	if((cnt & 0x0001) == 0x0001)
-		angle = (float)(((((uint16_t)buffer[0] << 8) + ((uint16_t)buffer[1])) & 0x0FFF) * 360.0 / 4096.0 );
-	else
-		angle = (float)ERROR;
+	/*Write each word once*/
+	for(k = 0; k < SL_WORDS; k++)
+		if(SRAMwrite(cs, buffer, 0x000C + k, data[k]) == ERROR)
+			return ERROR;
+
+	/*Set SB to 0 (Allow Segmented Linearization)*/
+	if(SRAMwrite(cs, buffer, 0x0006, flags & 0xFDFFFFFF) == ERROR)
+		return ERROR;
+
+	return ShadowFlush(cs, buffer);
+}
+
+int decodeAngleCount(uint16_t input, uint16_t *count)
+{
+	uint16_t cnt;
+
+	/*Parity of the 16 bits folded into the lsb*/
+	cnt = input ^ (input >> 8);
+	cnt ^= cnt >> 4;
+	cnt ^= cnt >> 2;
+	cnt ^= cnt >> 1;
 
-	return angle;
+	if((cnt & 0x0001) == 0x0000)
+		return PARITYERROR;
+
+	*count = input & 0x0FFF;
+
+	return NOERROR;
+}
+
+float decodeAngle(uint16_t input)
+{
+	uint16_t count;
+
+	if(decodeAngleCount(input, &count) != NOERROR)
+		return (float)ERROR;
+
+	return (float)(count * 360.0 / 4096.0);
+}
+
+float decodeTemp(uint16_t input)
+{
+	return (float)(((input & 0x0FFF) / 8.0) - 273.16);
+}
+
+float decodeField(uint16_t input)
+{
+	return (float)(input & 0x0FFF);
+}
+
+int getAngleCount(int cs, uint8_t buffer[], uint16_t *count)
+{
+	uint64_t start = MetricsTime();
+	int result;
+
+	/*Get the current angle reading the primary register 0x20:0x21*/
+	if(ReadRegister(cs, buffer, 0x20) == ERROR)
+		return ERROR;
+
+	result = decodeAngleCount(((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1], count);
+	if(result == PARITYERROR)
+		MetricsCount(cs, METRIC_PARITY, 1);
+
+	MetricsRecord(cs, METRIC_ANGLE, start);
+
+	return result;
+}
+
+int getAngleQ16(int cs, uint8_t buffer[], uint32_t *angle)
+{
+	uint16_t count;
+	int result;
+
+	/*Degrees in 16.16 fixed point: count * 360 / 4096 * 65536 is exact*/
+	if((result = getAngleCount(cs, buffer, &count)) != NOERROR)
+		return result;
+
+	*angle = (uint32_t)count * ANGLE_Q16_PER_COUNT;
+
+	return NOERROR;
+}
+
+float getAngle(int cs, uint8_t buffer[])
+{
+	uint16_t count;
+
+	if(getAngleCount(cs, buffer, &count) != NOERROR)
+		return (float)ERROR;
+
+	return (float)(count * 360.0 / 4096.0);
 }
 
 float getTemp(int cs, uint8_t buffer[])
 {
-	float temp = 0;
+	/*Get the current temperature reading the primary register 0x28:0x29, NAN if the transfer fails (counted in spi.c)*/
+	if(ReadRegister(cs, buffer, 0x28) == ERROR)
+		return NAN;
 
-	/*Get the current temperature reading the primary register 0x28:0x29*/
-	setBuffer(buffer, R, 0x28, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x28, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	
-	temp = (float)((((((uint16_t)buffer[0] << 8) + ((uint16_t)buffer[1])) & 0x0FFF) / 8.0) - 273.16);
-	
-	return temp;
+	return decodeTemp(((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1]);
 }
 
 float getField(int cs, uint8_t buffer[])
 {
-	float field = 0;
+	/*Get the current field reading the primary register 0x2A:0x2B, NAN if the transfer fails (counted in spi.c)*/
+	if(ReadRegister(cs, buffer, 0x2A) == ERROR)
+		return NAN;
 
-	/*Get the current field reading the primary register 0x2A:0x2B*/
-	setBuffer(buffer, R, 0x2A, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	setBuffer(buffer, R, 0x2A, 0x00);
-	wiringPiSPIDataRW(cs, buffer, 2);
-	
-	field = (float)((((uint16_t)buffer[0] << 8) + ((uint16_t)buffer[1])) & 0x0FFF);
-	
-	return field;
+	return decodeField(((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1]);
+}
+
+int getSnapshot(int cs, uint8_t buffer[], A1335snapshot *snapshot)
+{
+	SPIqueue queue;
+	uint16_t word[4];
+	uint64_t start = MetricsTime();
+	int i;
+
+	/*
+		Read angle, status, temperature and field in a single transfer of 5 frames:
+		each frame returns the register requested by the previous one, the last Read is repeated
+	*/
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, R, 0x20, 0x00);
+	SPIqueueFrame(&queue, R, 0x22, 0x00);
+	SPIqueueFrame(&queue, R, 0x28, 0x00);
+	SPIqueueFrame(&queue, R, 0x2A, 0x00);
+	SPIqueueFrame(&queue, R, 0x2A, 0x00);
+
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
+
+	for(i = 0; i < 4; i++)
+	{
+		SPIqueueResponse(&queue, i + 1, buffer);
+		word[i] = ((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1];
+	}
+
+	snapshot->angleWord = word[0];
+	snapshot->status = word[1];
+	snapshot->tempWord = word[2];
+	snapshot->fieldWord = word[3];
+
+	snapshot->angle = decodeAngle(word[0]);
+	snapshot->temp = decodeTemp(word[2]);
+	snapshot->field = decodeField(word[3]);
+
+	MetricsRecord(cs, METRIC_SNAPSHOT, start);
+
+	/*Parity error of the angle*/
+	if(decodeAngleCount(word[0], &word[0]) != NOERROR)
+	{
+		MetricsCount(cs, METRIC_PARITY, 1);
+		return PARITYERROR;
+	}
+
+	return NOERROR;
 }
@@ -17,6 +17,12 @@
 #define R 0x00				//Read Code [15:14] = 00
 #define NOERROR 0			//Codice assenza errore
 #define ERROR -1			//Codice errore generico
+#define PARITYERROR -2		//Parity check of the angle register failed
+#define STATE_IDLE 0x10		//Processor state code in the status register (Idle)
+#define STATE_RUN 0x11		//Processor state code in the status register (Run)
+#define ANGLE_EF 0x4000		//Error Flag of the angle register
+#define ANGLE_NF 0x2000		//New Flag of the angle register (new angle since the last reading)
+#define ANGLE_P 0x1000		//Parity bit of the angle register (odd parity)
 #define MINANGLE 0			//Min angle (in Degrees)
 #define MAXANGLE 90			//Max angle (in Degrees)
 #define DIRECTION 0			//Direction of rotation (0 = Clockwise | 0x12 = Counterclockwise)
@@ -25,6 +31,31 @@
 #define GAIN 0				//Gain = (360 / (MAXANGLE - MINANGLE)) - 1
 #define LINEARIZATION 1		//Segmented Linearization (1 = Yes | 0 = No)
 #define ENCODER 1			//Encoder for linearization setup (1 = Internal | 0 = External) (External Encoder common used)
+#define SL_COEFFICIENTS 15	//Number of Segmented Linearization coefficients
+#define SL_WORDS 8			//SRAM words holding the coefficients (addresses 0x0C:0x13)
+#define ORATE 7				//Output rate set by SRAMsetup(): 2^ORATE samples averaged, refresh time 32us * 2^ORATE
+#define ORATE_MAX 7			//Max output rate (128 samples, 4ms refresh time)
+#define ORATE_SAMPLE 32		//Time of one sample of the angle averaging (in us)
+#define ANGLE_COUNTS 4096	//Angle counts per turn (12 bits)
+#define ANGLE_Q16_PER_COUNT 5760	//One angle count in Degrees in 16.16 fixed point (360 * 65536 / 4096)
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Time coherent reading of the sensor channels*/
+typedef struct
+{
+	float angle;			//Angle (in Degrees), (float)ERROR if parity check fails
+	float temp;				//Temperature (in Celsius)
+	float field;			//Field
+	uint16_t angleWord;		//Raw primary register 0x20:0x21 (parity and flags included)
+	uint16_t status;		//Raw status register 0x22:0x23
+	uint16_t tempWord;		//Raw primary register 0x28:0x29
+	uint16_t fieldWord;		//Raw primary register 0x2A:0x2B
+} A1335snapshot;
 
 /*******************************************
 
@@ -33,19 +64,37 @@
 *******************************************/
 
 int setBuffer(uint8_t buffer[], uint8_t rw, uint8_t reg, uint8_t data);
+int ReadRegister(int cs, uint8_t buffer[], uint8_t reg);
 int ExtendedWrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value);
 int ExtendedRead(int cs, uint8_t buffer[], uint16_t address, uint32_t *value);
+int RequestProcessorState(int cs, uint8_t buffer[], uint8_t state);
+int CheckProcessorState(int cs, uint8_t buffer[], uint8_t state);
 int SetProcessorStateToRun(int cs, uint8_t buffer[]);
 int SetProcessorStateToIdle(int cs, uint8_t buffer[]);
 int UnlockDevice(int cs, uint8_t buffer[]);
 int EEPROMSetup(int cs, uint8_t buffer[]);
 int SRAMsetup(int cs, uint8_t buffer[]);
+int SRAMsetOutputRate(int cs, uint8_t buffer[]);
+int WriteOutputRate(int cs, uint8_t buffer[], uint8_t orate);
+int SetOutputRate(int cs, uint8_t buffer[], uint8_t orate);
+int SRAMwriteConfig(int cs, uint8_t buffer[], uint32_t *flags);
+int SRAMsetZeroOffset(int cs, uint8_t buffer[], uint32_t flags);
+int SRAMsetPreLinearizationOffset(int cs, uint8_t buffer[]);
 int SetSLCoefficients(int cs, uint8_t buffer[], float angle, int i);
+int SetSLCoefficientsBulk(int cs, uint8_t buffer[], float angle[]);
 int checkSelfTest(int cs, uint8_t buffer[]);
+int checkNewAngle(int cs, uint8_t buffer[]);
 int SoftReset(int cs, uint8_t buffer[]);
 int HardReset(int cs, uint8_t buffer[]);
+int getAngleCount(int cs, uint8_t buffer[], uint16_t *count);
+int getAngleQ16(int cs, uint8_t buffer[], uint32_t *angle);
 float getAngle(int cs, uint8_t buffer[]);
 float getTemp(int cs, uint8_t buffer[]);
 float getField(int cs, uint8_t buffer[]);
+int getSnapshot(int cs, uint8_t buffer[], A1335snapshot *snapshot);
+int decodeAngleCount(uint16_t input, uint16_t *count);
+float decodeAngle(uint16_t input);
+float decodeTemp(uint16_t input);
+float decodeField(uint16_t input);
 
 #endif
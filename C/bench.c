@@ -0,0 +1,478 @@
+/*******************************************************
+
+	University of Udine
+
+	Benchmark of the Allegro A1335 library against
+	the emulated sensor
+
+	Authors:
+	- Alessandro Fornasier
+
+	Requisites:
+	- WiringPi library
+
+	Compiling:
+	cc -O2 -o bench bench.c angle.c spi.c metrics.c shadow.c emulator.c -lwiringPi
+
+	Notes:
+	Every operation runs against emulator.c as bus
+	stand-in (no sensor needed), the report gives
+	ns/op (library and emulator CPU time, the SPI
+	clock is not modelled), frames/op and transfers/op.
+	With a baseline file (-b) the run fails if an
+	operation needs more frames or transfers than
+	the baseline, or more time than the baseline plus
+	the tolerance (-t, in %). -w writes the results
+	as new baseline. The times are scaled by the
+	reference (bit serial CRC-4 of every word, pure
+	CPU) of the run over the one of the baseline, so
+	a baseline recorded on another host still holds;
+	the operations waiting on delay() (SRAMsetup())
+	are compared as they are.
+	-c runs every operation with the CRC framing
+	(host and emulator, same frames and transfers):
+	the ns/op against a run without -c give the CRC
+	overhead, a line reports the CRC alone (table
+	driven and bit serial, ns/word).
+
+*******************************************************/
+
+/*******************************************************
+
+	Library:
+
+*******************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "angle.h"
+#include "spi.h"
+#include "emulator.h"
+#include "shadow.h"
+
+/*******************************************************
+
+	Definitions:
+
+*******************************************************/
+
+#define BENCH_ROUND_TIME 50000000ULL	//Min time of a round (in ns)
+#define BENCH_ROUNDS 5					//Rounds of an operation, the fastest gives ns/op
+#define BENCH_TOLERANCE 20.0			//Default time tolerance over the baseline (in %)
+#define BENCH_COUNT_TOLERANCE 0.005		//Frames and transfers are deterministic, rounding only
+#define BENCH_CRC_WORDS 65536			//Words of a round of the CRC benchmark (every 16 bit word)
+#define BENCH_REFERENCE "reference"		//Baseline line of the reference (bit serial CRC-4, ns/word)
+
+/*******************************************************
+
+	Types:
+
+*******************************************************/
+
+typedef struct
+{
+	const char *name;
+	int (*run)(int cs, uint8_t buffer[], uint32_t i);
+	uint32_t maxIterations;		//Cap of the iterations of a round for the slow operations (e.g. SRAMsetup() waits 200 ms)
+	int wallClock;				//Time set by delay(), not scaled by the reference
+	int shadow;					//Shadow copy of the SRAM attached (see shadow.c)
+} BenchOperation;
+
+typedef struct
+{
+	uint32_t iterations;
+	double ns;
+	double frames;
+	double transfers;
+} BenchResult;
+
+/*******************************************************
+
+	Variables:
+
+*******************************************************/
+
+static int crcFraming = 0;		//CRC framing of the operations (-c)
+static A1335shadow shadowCopy;
+
+/*******************************************************
+
+	Operations:
+
+*******************************************************/
+
+static int runAngle(int cs, uint8_t buffer[], uint32_t i)
+{
+	return (getAngle(cs, buffer) == (float)ERROR) ? ERROR : NOERROR;
+}
+
+static int runTemp(int cs, uint8_t buffer[], uint32_t i)
+{
+	return isnan(getTemp(cs, buffer)) ? ERROR : NOERROR;
+}
+
+static int runField(int cs, uint8_t buffer[], uint32_t i)
+{
+	return isnan(getField(cs, buffer)) ? ERROR : NOERROR;
+}
+
+static int runExtendedRead(int cs, uint8_t buffer[], uint32_t i)
+{
+	uint32_t value;
+
+	return ExtendedRead(cs, buffer, 0x0010, &value);
+}
+
+static int runExtendedWrite(int cs, uint8_t buffer[], uint32_t i)
+{
+	return ExtendedWrite(cs, buffer, 0x0010, i);
+}
+
+static int runSRAMsetup(int cs, uint8_t buffer[], uint32_t i)
+{
+	return SRAMsetup(cs, buffer);
+}
+
+static int runSLCoefficients(int cs, uint8_t buffer[], uint32_t i)
+{
+	int k;
+
+	/*The 15 coefficients, the last one writes back the bypass too*/
+	for(k = 1; k <= SL_COEFFICIENTS; k++)
+		if(SetSLCoefficients(cs, buffer, (float)((i + k) % 360), k) == ERROR)
+			return ERROR;
+
+	return NOERROR;
+}
+
+static int runSLCoefficientsBulk(int cs, uint8_t buffer[], uint32_t i)
+{
+	float angles[SL_COEFFICIENTS];
+	int k;
+
+	for(k = 0; k < SL_COEFFICIENTS; k++)
+		angles[k] = (float)((i + k + 1) % 360);
+
+	return SetSLCoefficientsBulk(cs, buffer, angles);
+}
+
+static int runSRAMread(int cs, uint8_t buffer[], uint32_t i)
+{
+	uint32_t value;
+
+	return SRAMread(cs, buffer, 0x0006, &value);
+}
+
+static int runSRAMwriteFlush(int cs, uint8_t buffer[], uint32_t i)
+{
+	if(SRAMwrite(cs, buffer, 0x0010, i) == ERROR)
+		return ERROR;
+
+	return ShadowFlush(cs, buffer);
+}
+
+static const BenchOperation operations[] =
+{
+	{"getAngle", runAngle, 0, 0, 0},
+	{"getTemp", runTemp, 0, 0, 0},
+	{"getField", runField, 0, 0, 0},
+	{"ExtendedRead", runExtendedRead, 0, 0, 0},
+	{"ExtendedWrite", runExtendedWrite, 0, 0, 0},
+	{"SRAMsetup", runSRAMsetup, 1, 1, 0},
+	{"SetSLCoefficients", runSLCoefficients, 0, 0, 0},
+	{"SetSLCoefficientsBulk", runSLCoefficientsBulk, 0, 0, 0},
+	{"ShadowSLCoefficientsBulk", runSLCoefficientsBulk, 0, 0, 1},
+	{"ShadowSRAMread", runSRAMread, 0, 0, 1},
+	{"ShadowSRAMwriteFlush", runSRAMwriteFlush, 0, 0, 1},
+};
+
+#define BENCH_OPERATIONS (int)(sizeof(operations) / sizeof(operations[0]))
+
+/*******************************************************
+
+	Functions:
+
+*******************************************************/
+
+static uint64_t now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static int runRound(const BenchOperation *op, uint8_t buffer[], uint32_t first, uint32_t n, uint64_t *elapsed)
+{
+	uint64_t start = now();
+	uint32_t i;
+
+	for(i = 0; i < n; i++)
+		if(op->run(0, buffer, first + i) == ERROR)
+			return ERROR;
+
+	*elapsed = now() - start;
+
+	return NOERROR;
+}
+
+static int bench(const BenchOperation *op, A1335emulator *emu, BenchResult *result)
+{
+	uint8_t buffer[BUFFER_SIZE];
+	SPIstats before, after;
+	uint64_t elapsed, best = 0;
+	uint32_t n = 1, done = 0;
+	int k;
+
+	/*Same sensor state for every operation (time moved by the frames: counts independent of the host), one warm up call*/
+	EmulatorInit(emu);
+	EmulatorSetFrameTime(emu, EMULATOR_FRAME_TIME);
+	EmulatorSetCRC(emu, crcFraming);
+
+	/*Fresh shadow: the warm up call loads the words used*/
+	ShadowDetach(0);
+	if(op->shadow)
+	{
+		ShadowInit(&shadowCopy);
+		ShadowAttach(0, &shadowCopy);
+	}
+
+	if(op->run(0, buffer, 0) == ERROR)
+		return ERROR;
+
+	SPIresetStats();
+	SPIgetStats(&before);
+
+	/*Iterations of a round: doubled until the round lasts BENCH_ROUND_TIME (or the cap)*/
+	while(1)
+	{
+		if(runRound(op, buffer, done + 1, n, &elapsed) == ERROR)
+			return ERROR;
+		done += n;
+
+		if((elapsed >= BENCH_ROUND_TIME) || ((op->maxIterations != 0) && (n * 2 > op->maxIterations)))
+			break;
+		n *= 2;
+	}
+
+	/*The fastest round is the least disturbed by the rest of the system*/
+	best = elapsed;
+	for(k = 1; k < BENCH_ROUNDS; k++)
+	{
+		if(runRound(op, buffer, done + 1, n, &elapsed) == ERROR)
+			return ERROR;
+		done += n;
+
+		if(elapsed < best)
+			best = elapsed;
+	}
+
+	SPIgetStats(&after);
+	ShadowDetach(0);
+
+	result->iterations = done;
+	result->ns = (double)best / (double)n;
+	result->frames = (double)(after.frames - before.frames) / (double)done;
+	result->transfers = (double)(after.transfers - before.transfers) / (double)done;
+
+	return NOERROR;
+}
+
+static double benchCRC(uint8_t (*crc)(uint16_t))
+{
+	volatile uint8_t sink;
+	uint64_t start, elapsed, best = 0;
+	uint8_t acc = 0;
+	uint32_t w;
+	int k;
+
+	/*Every word once per round, the fastest round*/
+	for(k = 0; k < BENCH_ROUNDS; k++)
+	{
+		start = now();
+		for(w = 0; w < BENCH_CRC_WORDS; w++)
+			acc ^= crc((uint16_t)w);
+		elapsed = now() - start;
+
+		if((k == 0) || (elapsed < best))
+			best = elapsed;
+	}
+	sink = acc;
+	(void)sink;
+
+	return (double)best / (double)BENCH_CRC_WORDS;
+}
+
+static uint8_t crcTable(uint16_t word)
+{
+	return SPIcrc(word);
+}
+
+static int readBaseline(const char *path, BenchResult baseline[], int found[], double *reference)
+{
+	char line[128], name[64];
+	double ns, frames, transfers;
+	FILE *fp;
+	int i;
+
+	if((fp = fopen(path, "r")) == NULL)
+		return ERROR;
+
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if((line[0] == '#') || (sscanf(line, "%63s %lf %lf %lf", name, &ns, &frames, &transfers) != 4))
+			continue;
+
+		if(strcmp(name, BENCH_REFERENCE) == 0)
+			*reference = ns;
+
+		for(i = 0; i < BENCH_OPERATIONS; i++)
+		{
+			if(strcmp(name, operations[i].name) == 0)
+			{
+				baseline[i].ns = ns;
+				baseline[i].frames = frames;
+				baseline[i].transfers = transfers;
+				found[i] = 1;
+			}
+		}
+	}
+
+	fclose(fp);
+
+	return NOERROR;
+}
+
+static int writeBaseline(const char *path, const BenchResult results[], double reference)
+{
+	FILE *fp;
+	int i;
+
+	if((fp = fopen(path, "w")) == NULL)
+		return ERROR;
+
+	fprintf(fp, "# operation ns/op frames/op transfers/op (ns/op 0 = not checked)\n");
+	fprintf(fp, "%s %.2f 0.00 0.00\n", BENCH_REFERENCE, reference);
+	for(i = 0; i < BENCH_OPERATIONS; i++)
+		fprintf(fp, "%s %.1f %.2f %.2f\n", operations[i].name, results[i].ns, results[i].frames, results[i].transfers);
+
+	fclose(fp);
+
+	return NOERROR;
+}
+
+/*******************************************************
+
+	Main function:
+
+*******************************************************/
+
+int main(int argc, char *argv[])
+{
+	static A1335emulator emu;
+	BenchResult results[BENCH_OPERATIONS], baseline[BENCH_OPERATIONS];
+	int found[BENCH_OPERATIONS];
+	const char *baselinePath = NULL, *outputPath = NULL;
+	double tolerance = BENCH_TOLERANCE, reference, baseReference = 0.0, expected;
+	int i, c, regressions = 0;
+	char verdict[64];
+
+	while((c = getopt(argc, argv, "b:w:t:c")) != -1)
+	{
+		switch(c)
+		{
+			case 'b': baselinePath = optarg; break;
+			case 'w': outputPath = optarg; break;
+			case 't': tolerance = atof(optarg); break;
+			case 'c': crcFraming = 1; break;
+			default:
+				printf("USE: [-b baseline] [-w baseline] [-t tolerance] [-c]\n\n\t-b: compare with the baseline file, exit 1 on regressions.\n\t-w: write the results as baseline file.\n\t-t: time tolerance over the baseline (in %%, default %.0f).\n\t-c: CRC framing.\n\n", BENCH_TOLERANCE);
+				return 1;
+		}
+	}
+
+	memset(found, 0, sizeof(found));
+	if((baselinePath != NULL) && (readBaseline(baselinePath, baseline, found, &baseReference) == ERROR))
+	{
+		fprintf(stderr, "Cannot read %s\n", baselinePath);
+		return 1;
+	}
+
+	SPIsetTransport(EmulatorTransfer, &emu);
+	SPIsetCRC(0, crcFraming);
+
+	/*Speed of the host: the baseline times are scaled by it*/
+	reference = benchCRC(SPIcrcBitwise);
+	printf("reference: %.2f ns/word (bit serial CRC-4)", reference);
+	if(baseReference > 0.0)
+		printf(", baseline %.2f ns/word", baseReference);
+	printf("\n");
+
+	if(crcFraming)
+		printf("CRC-4: %.2f ns/word table driven\n", benchCRC(crcTable));
+	printf("\n");
+
+	printf("%-24s %10s %12s %10s %13s  %s\n", "operation", "iterations", "ns/op", "frames/op", "transfers/op", (baselinePath != NULL) ? "baseline" : "");
+
+	for(i = 0; i < BENCH_OPERATIONS; i++)
+	{
+		if(bench(&operations[i], &emu, &results[i]) == ERROR)
+		{
+			printf("%-24s failed\n", operations[i].name);
+			regressions++;
+			memset(&results[i], 0, sizeof(BenchResult));
+			continue;
+		}
+
+		verdict[0] = '\0';
+		if((baselinePath != NULL) && !found[i])
+			snprintf(verdict, sizeof(verdict), "not in baseline");
+		else if(baselinePath != NULL)
+		{
+			/*Counts first: more bus traffic is a regression whatever the time*/
+			if(results[i].frames > baseline[i].frames + BENCH_COUNT_TOLERANCE)
+				snprintf(verdict, sizeof(verdict), "REGRESSION frames %.2f > %.2f", results[i].frames, baseline[i].frames);
+			else if(results[i].transfers > baseline[i].transfers + BENCH_COUNT_TOLERANCE)
+				snprintf(verdict, sizeof(verdict), "REGRESSION transfers %.2f > %.2f", results[i].transfers, baseline[i].transfers);
+			else
+			{
+				/*Baseline time on this host*/
+				expected = baseline[i].ns;
+				if(!operations[i].wallClock && (baseReference > 0.0))
+					expected *= reference / baseReference;
+
+				if((expected > 0.0) && (results[i].ns > expected * (1.0 + tolerance / 100.0)))
+					snprintf(verdict, sizeof(verdict), "REGRESSION time %+.1f%%", (results[i].ns / expected - 1.0) * 100.0);
+				else if(expected > 0.0)
+					snprintf(verdict, sizeof(verdict), "ok time %+.1f%%", (results[i].ns / expected - 1.0) * 100.0);
+				else
+					snprintf(verdict, sizeof(verdict), "ok");
+			}
+
+			if(strncmp(verdict, "REGRESSION", 10) == 0)
+				regressions++;
+		}
+
+		printf("%-24s %10u %12.1f %10.2f %13.2f  %s\n", operations[i].name, results[i].iterations, results[i].ns, results[i].frames, results[i].transfers, verdict);
+	}
+
+	if((outputPath != NULL) && (writeBaseline(outputPath, results, reference) == ERROR))
+	{
+		fprintf(stderr, "Cannot write %s\n", outputPath);
+		return 1;
+	}
+
+	if(regressions > 0)
+	{
+		printf("\n%d regression(s)\n", regressions);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*******************************************
+
+	University of Udine
+
+	Concurrent bring-up of many Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Each sensor runs the same sequence as the usage programs (reset, self test, unlock,
+	  EEPROMSetup(), SRAMsetup()) as a state machine
+	- A step that needs a settle time sets the wake time of its sensor and returns, meanwhile
+	  the steps of the other sensors are run: the settle times overlap instead of adding up
+	- The bring-up time of N sensors is the one of a single sensor plus the bus time
+	- With BRINGUP_FASTBOOT the settle times are replaced by polling the readiness bits (self test in
+	  XERR 0x26, processor state in 0x22, new angle flag in 0x20) with bounded deadlines
+	- The self test is checked once the sensor has answered after the reset (status register ID and
+	  run state, or a parity valid new angle): a ST bit at 0 alone is also read from a sensor still
+	  booting or from an empty bus
+	- The time from BringUpInit() to the first valid angle is reported in firstSample
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <wiringPi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "angle.h"
+#include "bringup.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static void wait(A1335bringup *sensor, uint32_t us, int step)
+{
+	sensor->wake = micros() + us;
+	sensor->deadline = sensor->wake;
+	sensor->step = step;
+}
+
+static void settle(A1335bringup *sensor, int options, uint32_t us, uint32_t deadline, int step)
+{
+	if(options & BRINGUP_FASTBOOT)
+	{
+		/*Check the readiness bit right away until the deadline*/
+		sensor->wake = micros();
+		sensor->deadline = sensor->wake + deadline;
+		sensor->step = step;
+	}
+	else
+		wait(sensor, us, step);
+}
+
+static int retry(A1335bringup *sensor)
+{
+	uint32_t now = micros();
+
+	/*Readiness bit not set within the deadline*/
+	if((int32_t)(now - sensor->deadline) >= 0)
+		return ERROR;
+
+	/*Run the same step again later*/
+	sensor->wake = now + BRINGUP_POLL_INTERVAL;
+
+	return NOERROR;
+}
+
+/*Positive sign of a booted sensor: status register ID (1000) with the run state, or a valid new angle*/
+static int booted(int cs, uint8_t buffer[])
+{
+	if((ReadRegister(cs, buffer, 0x22) == NOERROR) && ((buffer[0] & 0xF0) == 0x80) && (buffer[1] == STATE_RUN))
+		return NOERROR;
+
+	return checkNewAngle(cs, buffer);
+}
+
+static int bringupStep(A1335bringup *sensor, uint8_t buffer[], int options)
+{
+	int cs = sensor->cs;
+
+	switch(sensor->step)
+	{
+		case BRINGUP_RESET:
+			if(options & BRINGUP_SOFTRESET)
+			{
+				if(SoftReset(cs, buffer) == ERROR)
+					return ERROR;
+				settle(sensor, options, BRINGUP_RESET_SETTLE, BRINGUP_RESET_DEADLINE, BRINGUP_SELFTEST);
+			}
+			else if(options & BRINGUP_HARDRESET)
+			{
+				if(HardReset(cs, buffer) == ERROR)
+					return ERROR;
+				settle(sensor, options, BRINGUP_RESET_SETTLE, BRINGUP_RESET_DEADLINE, BRINGUP_SELFTEST);
+			}
+			else
+				wait(sensor, 0, BRINGUP_SELFTEST);
+			break;
+
+		case BRINGUP_SELFTEST:
+			/*ST at 0 is also what a booting sensor (or an empty bus) reads: the sensor must answer first*/
+			if(!sensor->ready)
+			{
+				if(booted(cs, buffer) == ERROR)
+					return retry(sensor);
+				sensor->ready = 1;
+			}
+			if(checkSelfTest(cs, buffer) == ERROR)
+				return retry(sensor);
+			wait(sensor, 0, BRINGUP_UNLOCK);
+			break;
+
+		case BRINGUP_UNLOCK:
+			if(UnlockDevice(cs, buffer) == ERROR)
+				return ERROR;
+			wait(sensor, 0, (options & BRINGUP_EEPROM) ? BRINGUP_EEPROM_IDLE : BRINGUP_SRAM_IDLE);
+			break;
+
+		/*EEPROMSetup()*/
+		case BRINGUP_EEPROM_IDLE:
+			if(RequestProcessorState(cs, buffer, STATE_IDLE) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_STATE_SETTLE, BRINGUP_STATE_DEADLINE, BRINGUP_EEPROM_RUN);
+			break;
+
+		case BRINGUP_EEPROM_RUN:
+			if(CheckProcessorState(cs, buffer, STATE_IDLE) == ERROR)
+				return retry(sensor);
+			if(RequestProcessorState(cs, buffer, STATE_RUN) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_STATE_SETTLE, BRINGUP_STATE_DEADLINE, BRINGUP_EEPROM_DONE);
+			break;
+
+		case BRINGUP_EEPROM_DONE:
+			if(CheckProcessorState(cs, buffer, STATE_RUN) == ERROR)
+				return retry(sensor);
+			wait(sensor, 0, BRINGUP_SRAM_IDLE);
+			break;
+
+		/*SRAMsetup()*/
+		case BRINGUP_SRAM_IDLE:
+			if(RequestProcessorState(cs, buffer, STATE_IDLE) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_STATE_SETTLE, BRINGUP_STATE_DEADLINE, BRINGUP_SRAM_ORATE);
+			break;
+
+		case BRINGUP_SRAM_ORATE:
+			if(CheckProcessorState(cs, buffer, STATE_IDLE) == ERROR)
+				return retry(sensor);
+			if(SRAMsetOutputRate(cs, buffer) == ERROR)
+				return ERROR;
+			if(RequestProcessorState(cs, buffer, STATE_RUN) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_STATE_SETTLE, BRINGUP_STATE_DEADLINE, BRINGUP_SRAM_RUN);
+			break;
+
+		case BRINGUP_SRAM_RUN:
+			if(CheckProcessorState(cs, buffer, STATE_RUN) == ERROR)
+				return retry(sensor);
+			if(SRAMwriteConfig(cs, buffer, &sensor->flags) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_ANGLE_SETTLE, BRINGUP_ANGLE_DEADLINE, BRINGUP_SRAM_ZERO);
+			break;
+
+		case BRINGUP_SRAM_ZERO:
+			if((options & BRINGUP_FASTBOOT) && (checkNewAngle(cs, buffer) == ERROR))
+				return retry(sensor);
+			if(SRAMsetZeroOffset(cs, buffer, sensor->flags) == ERROR)
+				return ERROR;
+			settle(sensor, options, BRINGUP_ANGLE_SETTLE, BRINGUP_ANGLE_DEADLINE, BRINGUP_SRAM_PRELINEARIZATION);
+			break;
+
+		case BRINGUP_SRAM_PRELINEARIZATION:
+			if((options & BRINGUP_FASTBOOT) && (checkNewAngle(cs, buffer) == ERROR))
+				return retry(sensor);
+			if(SRAMsetPreLinearizationOffset(cs, buffer) == ERROR)
+				return ERROR;
+
+			/*Wait for the first angle computed with the new configuration*/
+			sensor->wake = micros();
+			sensor->deadline = sensor->wake + BRINGUP_ANGLE_DEADLINE;
+			sensor->step = BRINGUP_FIRST_SAMPLE;
+			break;
+
+		case BRINGUP_FIRST_SAMPLE:
+			if(checkNewAngle(cs, buffer) == ERROR)
+				return retry(sensor);
+			sensor->firstSample = micros() - sensor->start;
+			wait(sensor, 0, BRINGUP_DONE);
+			break;
+	}
+
+	return NOERROR;
+}
+
+void BringUpInit(A1335bringup *sensor, int cs)
+{
+	sensor->cs = cs;
+	sensor->step = BRINGUP_RESET;
+	sensor->ready = 0;
+	sensor->result = NOERROR;
+	sensor->start = micros();
+	sensor->wake = sensor->start;
+	sensor->deadline = sensor->start;
+	sensor->flags = 0x00000000;
+	sensor->firstSample = 0;
+}
+
+int BringUp(A1335bringup sensors[], int n, int options)
+{
+	uint8_t buffer[BUFFER_SIZE];
+	int32_t remaining, earliest;
+	int i, pending, result = NOERROR;
+
+	do
+	{
+		pending = 0;
+		earliest = 0;
+
+		for(i = 0; i < n; i++)
+		{
+			if((sensors[i].step == BRINGUP_DONE) || (sensors[i].result == ERROR))
+				continue;
+
+			/*Run the step if its settle time is over*/
+			remaining = (int32_t)(sensors[i].wake - micros());
+			if(remaining <= 0)
+			{
+				if(bringupStep(&sensors[i], buffer, options) == ERROR)
+				{
+					sensors[i].result = ERROR;
+					result = ERROR;
+					continue;
+				}
+
+				if(sensors[i].step == BRINGUP_DONE)
+					continue;
+
+				remaining = (int32_t)(sensors[i].wake - micros());
+			}
+
+			if((pending == 0) || (remaining < earliest))
+				earliest = remaining;
+			pending++;
+		}
+
+		/*Sleep until the first settle time is over*/
+		if((pending > 0) && (earliest > 0))
+			delayMicroseconds(earliest);
+
+	} while(pending > 0);
+
+	return result;
+}
+
+const char *BringUpStepName(int step)
+{
+	switch(step)
+	{
+		case BRINGUP_RESET:					return "Reset";
+		case BRINGUP_SELFTEST:				return "Self Test";
+		case BRINGUP_UNLOCK:				return "Unlock";
+		case BRINGUP_EEPROM_IDLE:
+		case BRINGUP_EEPROM_RUN:
+		case BRINGUP_EEPROM_DONE:			return "Setup EEPROM";
+		case BRINGUP_SRAM_IDLE:
+		case BRINGUP_SRAM_ORATE:
+		case BRINGUP_SRAM_RUN:
+		case BRINGUP_SRAM_ZERO:
+		case BRINGUP_SRAM_PRELINEARIZATION:	return "Setup SRAM";
+		case BRINGUP_FIRST_SAMPLE:			return "First Sample";
+		case BRINGUP_DONE:					return "Done";
+	}
+
+	return "Unknown";
+}
@@ -0,0 +1,77 @@
+#ifndef BRINGUP_H__
+#define BRINGUP_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define BRINGUP_MAX_SENSORS 32		//Max number of sensors driven together
+
+/*Options*/
+#define BRINGUP_SOFTRESET 0x01		//Soft reset before the setup
+#define BRINGUP_HARDRESET 0x02		//Hard reset before the setup
+#define BRINGUP_EEPROM 0x04			//Run EEPROMSetup()
+#define BRINGUP_FASTBOOT 0x08		//Poll the readiness bits instead of waiting the settle times
+
+/*Settle times (in us)*/
+#define BRINGUP_RESET_SETTLE 100000		//After reset, before the self test
+#define BRINGUP_STATE_SETTLE 1000		//After a processor state command
+#define BRINGUP_ANGLE_SETTLE 100000		//After the SRAM configuration, before each angle reading
+
+/*Deadlines of the fast boot polling (in us)*/
+#define BRINGUP_POLL_INTERVAL 50			//Time between two readings of a readiness bit
+#define BRINGUP_RESET_DEADLINE 200000		//Self test passed (ST bit of XERR 0x26)
+#define BRINGUP_STATE_DEADLINE 10000		//Processor state reached (status register 0x22)
+#define BRINGUP_ANGLE_DEADLINE 200000		//New angle available (NF bit of the angle register 0x20)
+
+/*Steps*/
+#define BRINGUP_RESET 0
+#define BRINGUP_SELFTEST 1
+#define BRINGUP_UNLOCK 2
+#define BRINGUP_EEPROM_IDLE 3
+#define BRINGUP_EEPROM_RUN 4
+#define BRINGUP_EEPROM_DONE 5
+#define BRINGUP_SRAM_IDLE 6
+#define BRINGUP_SRAM_ORATE 7
+#define BRINGUP_SRAM_RUN 8
+#define BRINGUP_SRAM_ZERO 9
+#define BRINGUP_SRAM_PRELINEARIZATION 10
+#define BRINGUP_FIRST_SAMPLE 11
+#define BRINGUP_DONE 12
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Bring-up state machine of a single sensor*/
+typedef struct
+{
+	int cs;
+	int step;			//Next step to run (BRINGUP_DONE when finished)
+	int result;			//NOERROR, ERROR if the step failed
+	uint32_t wake;		//micros() at which the step can run
+	uint32_t deadline;	//micros() after which the step fails if its readiness bit is not set
+	int ready;			//The sensor answered after the reset (status or angle), the self test can be trusted
+	uint32_t flags;		//SRAM address 0x06 content (from SRAMwriteConfig())
+	uint32_t start;		//micros() of BringUpInit()
+	uint32_t firstSample;	//Time to first valid sample (in us)
+} A1335bringup;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void BringUpInit(A1335bringup *sensor, int cs);
+int BringUp(A1335bringup sensors[], int n, int options);
+const char *BringUpStepName(int step);
+
+#endif
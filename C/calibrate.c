@@ -0,0 +1,208 @@
+/*******************************************
+
+	University of Udine
+
+	SPI clock calibration of the Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- CalibrateClock() steps the SPI clock of a chip select up from SPI_CLOCK (1, 2, 4, 5, 8, 10,
+	  12.5, 16, 20, 25 MHz up to maxClock) and validates many frames at each clock:
+	  - readback of a known register: a pattern written into EWA (0x02:0x03) and read back in the
+	    same transfer (writing EWA alone starts nothing)
+	  - angle parity (getAngleCount())
+	  - register ID of the temperature register (4 MSB of 0x28 at 1111)
+	  - CRC of every response when the CRC framing of the chip select is on (see spi.c)
+	- A clock is accepted if the failed checks are at most maxErrorRate of its frames (a clock stops
+	  as soon as it cannot pass), the stepping stops at the first clock refused. The clock chosen is
+	  backoff steps below the highest clock accepted, as margin for temperature and supply, and is
+	  set with SPIsetSpeed(). ERROR if SPI_CLOCK itself fails (SPI_CLOCK kept)
+	- The controller rounds each clock down to one it can generate (e.g. the core clock over an
+	  even divider on the Raspberry Pi): the steps are the clocks asked for
+	- EWA is left with the last pattern: the next extended write sets it anyway
+	- CalibrateSave() writes the clocks set of every chip select into a text file ("cs clock" per
+	  line), CalibrateLoad() sets them again at start up without calibrating
+	- Shorter frames leave more bus time for the other sensors (see scheduler.c)
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "angle.h"
+#include "spi.h"
+#include "calibrate.h"
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static const uint32_t clocks[] =
+{
+	1000000, 2000000, 4000000, 5000000, 8000000, 10000000, 12500000, 16000000, 20000000, 25000000
+};
+
+#define CALIBRATE_CLOCKS (int)(sizeof(clocks) / sizeof(clocks[0]))
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+void CalibrateDefaults(A1335calibration *config)
+{
+	config->maxClock = CALIBRATE_MAX_CLOCK;
+	config->frames = CALIBRATE_FRAMES;
+	config->maxErrorRate = CALIBRATE_ERROR_RATE;
+	config->backoff = CALIBRATE_BACKOFF;
+}
+
+/*Pattern written into EWA and read back: 4 frames, 1 if the word read differs*/
+static int readback(int cs, uint8_t buffer[], uint16_t pattern)
+{
+	SPIqueue queue;
+
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, W, 0x02, (uint8_t)(pattern >> 8));
+	SPIqueueFrame(&queue, W, 0x03, (uint8_t)(pattern & 0x00FF));
+	SPIqueueFrame(&queue, R, 0x02, 0x00);
+	SPIqueueFrame(&queue, R, 0x02, 0x00);
+
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return 1;
+
+	SPIqueueResponse(&queue, 3, buffer);
+
+	return ((((uint16_t)buffer[0] << 8) | buffer[1]) != pattern) ? 1 : 0;
+}
+
+int CalibrateValidate(int cs, uint8_t buffer[], uint32_t clock, uint32_t frames, uint32_t maxErrors, A1335clockStep *step)
+{
+	uint16_t count, pattern = 0xA5C3;
+
+	if(SPIsetSpeed(cs, clock) == ERROR)
+		return ERROR;
+
+	memset(step, 0, sizeof(A1335clockStep));
+	step->clock = clock;
+
+	/*8 frames a round: readback (4), angle (2), temperature (2)*/
+	while((step->frames < frames) && (step->errors <= maxErrors))
+	{
+		/*Every bit of the word both ways across the rounds*/
+		pattern = (uint16_t)((pattern << 1) | (((pattern >> 15) ^ (pattern >> 13) ^ (pattern >> 12) ^ (pattern >> 10)) & 0x0001));
+
+		step->errors += readback(cs, buffer, pattern);
+
+		if(getAngleCount(cs, buffer, &count) != NOERROR)
+			step->errors++;
+
+		if((ReadRegister(cs, buffer, 0x28) == ERROR) || ((buffer[0] & 0xF0) != 0xF0))
+			step->errors++;
+
+		step->frames += 8;
+	}
+
+	step->errorRate = (double)step->errors / (double)step->frames;
+	step->passed = (step->errors <= maxErrors);
+
+	return NOERROR;
+}
+
+int CalibrateClock(int cs, uint8_t buffer[], const A1335calibration *config, A1335calibrationResult *result)
+{
+	uint32_t maxErrors = (uint32_t)(config->maxErrorRate * (double)config->frames);
+	int i, accepted = -1;
+
+	memset(result, 0, sizeof(A1335calibrationResult));
+
+	/*Up from SPI_CLOCK until a clock is refused*/
+	for(i = 0; (i < CALIBRATE_CLOCKS) && (result->n < CALIBRATE_MAX_STEPS); i++)
+	{
+		if((clocks[i] < SPI_CLOCK) || (clocks[i] > config->maxClock))
+			continue;
+
+		if(CalibrateValidate(cs, buffer, clocks[i], config->frames, maxErrors, &result->steps[result->n]) == ERROR)
+			return ERROR;
+
+		if(!result->steps[result->n++].passed)
+			break;
+
+		accepted = result->n - 1;
+	}
+
+	/*Not even SPI_CLOCK*/
+	if(accepted < 0)
+	{
+		SPIsetSpeed(cs, 0);
+		result->clock = SPI_CLOCK;
+		return ERROR;
+	}
+
+	/*Margin below the highest clock accepted*/
+	accepted = (accepted > config->backoff) ? accepted - config->backoff : 0;
+	result->clock = result->steps[accepted].clock;
+
+	return SPIsetSpeed(cs, result->clock);
+}
+
+int CalibrateSave(const char *path)
+{
+	SPIdevice device;
+	FILE *fp;
+	int cs;
+
+	if((fp = fopen(path, "w")) == NULL)
+		return ERROR;
+
+	fprintf(fp, "# cs clock (in Hz)\n");
+	for(cs = 0; cs < SPI_MAX_DEVICES; cs++)
+		if((SPIgetDevice(cs, &device) == NOERROR) && (device.speed != 0))
+			fprintf(fp, "%d %u\n", cs, device.speed);
+
+	if(fclose(fp) != 0)
+		return ERROR;
+
+	return NOERROR;
+}
+
+int CalibrateLoad(const char *path)
+{
+	char line[64];
+	unsigned int clock;
+	FILE *fp;
+	int cs, result = NOERROR;
+
+	if((fp = fopen(path, "r")) == NULL)
+		return ERROR;
+
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if((line[0] == '#') || (sscanf(line, "%d %u", &cs, &clock) != 2))
+			continue;
+
+		if(SPIsetSpeed(cs, clock) == ERROR)
+			result = ERROR;
+	}
+
+	fclose(fp);
+
+	return result;
+}
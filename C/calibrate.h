@@ -0,0 +1,64 @@
+#ifndef CALIBRATE_H__
+#define CALIBRATE_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define CALIBRATE_MAX_STEPS 16			//Max number of clocks tried
+#define CALIBRATE_MAX_CLOCK 10000000	//Default highest clock tried (in Hz)
+#define CALIBRATE_FRAMES 20000			//Default frames validated at each clock
+#define CALIBRATE_ERROR_RATE 0.0		//Default max share of frames in error of a clock accepted
+#define CALIBRATE_BACKOFF 1				//Default steps below the highest clock accepted
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Settings of the calibration*/
+typedef struct
+{
+	uint32_t maxClock;		//Highest clock tried (in Hz)
+	uint32_t frames;		//Frames validated at each clock
+	double maxErrorRate;	//Max share of frames in error of a clock accepted
+	int backoff;			//Steps below the highest clock accepted (margin for temperature, supply, ...)
+} A1335calibration;
+
+/*Validation at one clock*/
+typedef struct
+{
+	uint32_t clock;			//SPI clock (in Hz)
+	uint32_t frames;		//Frames exchanged
+	uint32_t errors;		//Frames in error (parity, CRC, readback, failed transfers)
+	double errorRate;		//errors / frames
+	int passed;				//errorRate <= maxErrorRate
+} A1335clockStep;
+
+/*Result of the calibration of a sensor*/
+typedef struct
+{
+	int n;										//Clocks tried
+	A1335clockStep steps[CALIBRATE_MAX_STEPS];
+	uint32_t clock;								//Clock chosen and set (in Hz)
+} A1335calibrationResult;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void CalibrateDefaults(A1335calibration *config);
+int CalibrateValidate(int cs, uint8_t buffer[], uint32_t clock, uint32_t frames, uint32_t maxErrors, A1335clockStep *step);
+int CalibrateClock(int cs, uint8_t buffer[], const A1335calibration *config, A1335calibrationResult *result);
+int CalibrateSave(const char *path);
+int CalibrateLoad(const char *path);
+
+#endif
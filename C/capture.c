@@ -0,0 +1,372 @@
+/*******************************************
+
+	University of Udine
+
+	Capture and replay of the SPI traffic of
+	the Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- CaptureOpen() records every transfer of the SPI layer (any transport): end time, chip select,
+	  result and the words sent and received of each frame, 16 bytes plus 4 bytes per frame
+	- The records go through a large stdio buffer: a transfer costs a memory copy under a mutex
+	  (many threads can capture), CaptureFlush() writes the buffer out
+	- count in the header is written by CaptureClose(), a capture not closed is read up to its
+	  last complete transfer
+	- ReplayOpen() maps a capture and indexes the transfers of each chip select, ReplayTransfer()
+	  as transport (SPIsetTransport(ReplayTransfer, &replay)) answers each transfer with the
+	  responses recorded for the next transfer of the same chip select, without waiting: the
+	  driver, decoding and logging run at CPU speed on the recorded data
+	- A transfer different from the recorded one (frames or words sent) is counted, the recorded
+	  responses are returned anyway unless REPLAY_STRICT. At the end of a chip select the transfers
+	  fail, or start again with REPLAY_LOOP
+	- The words are recorded without their CRC, the replay answers with a valid CRC: the CRC
+	  framing runs on a replay as on the sensor
+	- The chip selects are replayed independently (one thread each), the statistics are exact
+	  with a single replaying thread
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "angle.h"
+#include "spi.h"
+#include "capture.h"
+
+/*The file format does not depend on the compiler*/
+_Static_assert(sizeof(A1335captureHeader) == 64, "A1335captureHeader must be 64 bytes");
+_Static_assert(sizeof(A1335captureRecord) == 16, "A1335captureRecord must be 16 bytes");
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static FILE *captureFile = NULL;
+static char *captureBuffer = NULL;
+static uint64_t captureCount = 0;
+static pthread_mutex_t captureLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static uint64_t captureTime(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void captureTransfer(int cs, const uint8_t sent[][SPI_FRAME_SIZE], const uint8_t received[][SPI_FRAME_SIZE], int n, int result, void *ctx)
+{
+	uint8_t frames[SPI_MAX_FRAMES][CAPTURE_FRAME_SIZE];
+	A1335captureRecord record;
+	int i;
+
+	memset(&record, 0, sizeof(record));
+	record.timestamp = captureTime();
+	record.device = (uint16_t)cs;
+	record.frames = (uint8_t)n;
+	record.result = (int8_t)result;
+
+	/*Word sent then word received of each frame*/
+	for(i = 0; i < n; i++)
+	{
+		frames[i][0] = sent[i][0];
+		frames[i][1] = sent[i][1];
+		frames[i][2] = received[i][0];
+		frames[i][3] = received[i][1];
+	}
+
+	pthread_mutex_lock(&captureLock);
+	if(captureFile != NULL)
+	{
+		fwrite(&record, sizeof(record), 1, captureFile);
+		fwrite(frames, CAPTURE_FRAME_SIZE, (size_t)n, captureFile);
+		captureCount++;
+	}
+	pthread_mutex_unlock(&captureLock);
+}
+
+int CaptureOpen(const char *path)
+{
+	A1335captureHeader header;
+
+	if(captureFile != NULL)
+		return ERROR;
+
+	if((captureFile = fopen(path, "wb")) == NULL)
+		return ERROR;
+
+	captureBuffer = malloc(CAPTURE_BUFFER);
+	if(captureBuffer != NULL)
+		setvbuf(captureFile, captureBuffer, _IOFBF, CAPTURE_BUFFER);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.version = CAPTURE_VERSION;
+	header.recordSize = sizeof(A1335captureRecord);
+	header.start = captureTime();
+	header.count = 0;
+
+	if(fwrite(&header, sizeof(header), 1, captureFile) != 1)
+	{
+		fclose(captureFile);
+		free(captureBuffer);
+		captureFile = NULL;
+		captureBuffer = NULL;
+		return ERROR;
+	}
+
+	captureCount = 0;
+	SPIsetCapture(captureTransfer, NULL);
+
+	return NOERROR;
+}
+
+int CaptureFlush(void)
+{
+	int result = NOERROR;
+
+	pthread_mutex_lock(&captureLock);
+	if((captureFile == NULL) || (fflush(captureFile) != 0))
+		result = ERROR;
+	pthread_mutex_unlock(&captureLock);
+
+	return result;
+}
+
+int CaptureClose(void)
+{
+	uint64_t count;
+	int result = NOERROR;
+
+	SPIsetCapture(NULL, NULL);
+
+	pthread_mutex_lock(&captureLock);
+
+	if(captureFile == NULL)
+	{
+		pthread_mutex_unlock(&captureLock);
+		return ERROR;
+	}
+
+	/*Number of transfers into the header*/
+	count = captureCount;
+	if((fseek(captureFile, offsetof(A1335captureHeader, count), SEEK_SET) != 0) || (fwrite(&count, sizeof(count), 1, captureFile) != 1))
+		result = ERROR;
+
+	if(fclose(captureFile) != 0)
+		result = ERROR;
+
+	free(captureBuffer);
+	captureFile = NULL;
+	captureBuffer = NULL;
+
+	pthread_mutex_unlock(&captureLock);
+
+	return result;
+}
+
+uint64_t CaptureCount(void)
+{
+	uint64_t count;
+
+	pthread_mutex_lock(&captureLock);
+	count = captureCount;
+	pthread_mutex_unlock(&captureLock);
+
+	return count;
+}
+
+/*Offset of the transfer after the one at offset, 0 if the file ends first*/
+static size_t nextRecord(const A1335replay *replay, size_t offset, A1335captureRecord *record)
+{
+	if(offset + sizeof(A1335captureRecord) > replay->size)
+		return 0;
+
+	memcpy(record, replay->data + offset, sizeof(A1335captureRecord));
+	offset += sizeof(A1335captureRecord) + (size_t)record->frames * CAPTURE_FRAME_SIZE;
+
+	if((offset > replay->size) || (record->frames > SPI_MAX_FRAMES))
+		return 0;
+
+	return offset;
+}
+
+int ReplayOpen(A1335replay *replay, const char *path, int options)
+{
+	A1335captureHeader header;
+	A1335captureRecord record;
+	struct stat st;
+	size_t offset, next;
+	int fd, cs;
+
+	memset(replay, 0, sizeof(A1335replay));
+	replay->options = options;
+
+	if((fd = open(path, O_RDONLY)) < 0)
+		return ERROR;
+
+	if((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(header)))
+	{
+		close(fd);
+		return ERROR;
+	}
+
+	replay->size = (size_t)st.st_size;
+	replay->data = mmap(NULL, replay->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(replay->data == MAP_FAILED)
+	{
+		replay->data = NULL;
+		return ERROR;
+	}
+
+	memcpy(&header, replay->data, sizeof(header));
+	if((memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0) || (header.version != CAPTURE_VERSION) || (header.recordSize != sizeof(A1335captureRecord)))
+	{
+		ReplayClose(replay);
+		return ERROR;
+	}
+
+	/*First pass: transfers of each chip select (up to the last complete one)*/
+	for(offset = sizeof(header); (next = nextRecord(replay, offset, &record)) != 0; offset = next)
+	{
+		if(record.device < SPI_MAX_DEVICES)
+			replay->n[record.device]++;
+		replay->count++;
+	}
+
+	for(cs = 0; cs < SPI_MAX_DEVICES; cs++)
+	{
+		if(replay->n[cs] == 0)
+			continue;
+
+		if((replay->offsets[cs] = malloc(replay->n[cs] * sizeof(size_t))) == NULL)
+		{
+			ReplayClose(replay);
+			return ERROR;
+		}
+		replay->n[cs] = 0;
+	}
+
+	/*Second pass: index of each chip select*/
+	for(offset = sizeof(header); (next = nextRecord(replay, offset, &record)) != 0; offset = next)
+		if(record.device < SPI_MAX_DEVICES)
+			replay->offsets[record.device][replay->n[record.device]++] = offset;
+
+	return NOERROR;
+}
+
+int ReplayTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx)
+{
+	A1335replay *replay = (A1335replay *)ctx;
+	A1335captureRecord record;
+	const uint8_t *recorded;
+	int i, mismatch;
+
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	if(replay->next[cs] >= replay->n[cs])
+	{
+		if(!(replay->options & REPLAY_LOOP) || (replay->n[cs] == 0))
+		{
+			replay->exhausted++;
+			return ERROR;
+		}
+		replay->next[cs] = 0;
+	}
+
+	memcpy(&record, replay->data + replay->offsets[cs][replay->next[cs]++], sizeof(record));
+	recorded = replay->data + replay->offsets[cs][replay->next[cs] - 1] + sizeof(record);
+
+	/*Same frames sent as recorded*/
+	mismatch = (record.frames != n);
+	for(i = 0; (i < n) && (i < record.frames) && !mismatch; i++)
+		mismatch = (frames[i][0] != recorded[4 * i]) || (frames[i][1] != recorded[4 * i + 1]);
+
+	if(mismatch)
+	{
+		replay->mismatches++;
+		if(replay->options & REPLAY_STRICT)
+			return ERROR;
+	}
+
+	/*Recorded responses, 0 for the frames not recorded, with their CRC (for the CRC framing)*/
+	for(i = 0; i < n; i++)
+	{
+		frames[i][0] = (i < record.frames) ? recorded[4 * i + 2] : 0x00;
+		frames[i][1] = (i < record.frames) ? recorded[4 * i + 3] : 0x00;
+		frames[i][2] = (uint8_t)(SPIcrc(((uint16_t)frames[i][0] << 8) | frames[i][1]) << 4);
+	}
+
+	replay->replayed++;
+
+	return record.result;
+}
+
+void ReplayRewind(A1335replay *replay)
+{
+	memset(replay->next, 0, sizeof(replay->next));
+	replay->replayed = 0;
+	replay->mismatches = 0;
+	replay->exhausted = 0;
+}
+
+int ReplayRecord(A1335replay *replay, int cs, uint64_t i, A1335captureRecord *record, const uint8_t **frames)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES) || (i >= replay->n[cs]))
+		return ERROR;
+
+	/*Frames: word sent then word received of each frame (4 bytes)*/
+	memcpy(record, replay->data + replay->offsets[cs][i], sizeof(A1335captureRecord));
+	*frames = replay->data + replay->offsets[cs][i] + sizeof(A1335captureRecord);
+
+	return NOERROR;
+}
+
+void ReplayClose(A1335replay *replay)
+{
+	int cs;
+
+	for(cs = 0; cs < SPI_MAX_DEVICES; cs++)
+	{
+		free(replay->offsets[cs]);
+		replay->offsets[cs] = NULL;
+	}
+
+	if(replay->data != NULL)
+		munmap(replay->data, replay->size);
+
+	replay->data = NULL;
+}
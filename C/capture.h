@@ -0,0 +1,84 @@
+#ifndef CAPTURE_H__
+#define CAPTURE_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+#include "spi.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define CAPTURE_MAGIC "A1335CAP"		//First 8 bytes of the file
+#define CAPTURE_VERSION 1
+#define CAPTURE_BUFFER 1048576			//Write buffer of the capture (in bytes)
+#define CAPTURE_FRAME_SIZE 4			//Word sent and word received of a frame (in bytes)
+
+/*Replay options*/
+#define REPLAY_LOOP 0x01		//Start again from the first transfer of a chip select at the end
+#define REPLAY_STRICT 0x02		//A transfer different from the one recorded fails (ERROR)
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*File header (64 bytes), the transfers follow*/
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;		//sizeof(A1335captureRecord)
+	uint64_t start;				//CLOCK_MONOTONIC time of CaptureOpen() (in ns)
+	uint64_t count;				//Number of transfers (written by CaptureClose(), 0 if not closed)
+	uint8_t reserved[32];
+} A1335captureHeader;
+
+/*Transfer (16 bytes, little endian as written by the host), followed by frames x (sent, received) words*/
+typedef struct
+{
+	uint64_t timestamp;			//CLOCK_MONOTONIC time of the end of the transfer (in ns)
+	uint16_t device;			//Chip select
+	uint8_t frames;				//Number of frames
+	int8_t result;				//NOERROR or ERROR as returned by the transport
+	uint32_t reserved;
+} A1335captureRecord;
+
+/*Capture loaded for replay*/
+typedef struct
+{
+	uint8_t *data;							//Whole file
+	size_t size;
+	uint64_t count;							//Transfers in the file
+	size_t *offsets[SPI_MAX_DEVICES];		//Offsets of the transfers of each chip select
+	uint64_t n[SPI_MAX_DEVICES];			//Transfers of each chip select
+	uint64_t next[SPI_MAX_DEVICES];			//Next transfer replayed of each chip select
+	int options;							//REPLAY_LOOP, REPLAY_STRICT
+
+	/*Statistics*/
+	uint64_t replayed;						//Transfers replayed
+	uint64_t mismatches;					//Transfers different from the recorded ones (chip select, frames or data sent)
+	uint64_t exhausted;						//Transfers requested after the end of a chip select
+} A1335replay;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int CaptureOpen(const char *path);
+int CaptureFlush(void);
+int CaptureClose(void);
+uint64_t CaptureCount(void);
+int ReplayOpen(A1335replay *replay, const char *path, int options);
+int ReplayTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx);
+void ReplayRewind(A1335replay *replay);
+int ReplayRecord(A1335replay *replay, int cs, uint64_t i, A1335captureRecord *record, const uint8_t **frames);
+void ReplayClose(A1335replay *replay);
+
+#endif
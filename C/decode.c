@@ -0,0 +1,415 @@
+/*******************************************
+
+	University of Udine
+
+	Batch decoding of the Allegro A1335 raw
+	register words
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The results are bit exact with decodeAngle(), decodeTemp() and decodeField():
+		- angle: (word & 0x0FFF) * 45 and the division by 512 are exact in float, so the float
+		  kernels give the same value of the double expression rounded to float
+		- temperature: computed in double lanes as decodeTemp() ((word & 0x0FFF) / 8.0 is exact,
+		  only the subtraction rounds), then rounded to float
+		- field: (word & 0x0FFF) is exact in float
+	- The products are exact, so a compiler contracting them into fused multiply-add does not
+	  change the results
+	- Kernels: AVX2 (selected at run time on x86), SSE2 (x86 baseline), NEON (ARM, the temperature
+	  uses double lanes on AArch64 only) and a scalar fallback, used for the remainder too
+	- Define DECODE_SCALAR to build the scalar kernel only, DECODE_NOAVX2 to leave out AVX2 (SSE2
+	  on any x86, e.g. to check it with decode_check.c on an AVX2 host)
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "angle.h"
+#include "decode.h"
+
+#if !defined(DECODE_SCALAR) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define DECODE_X86
+#include <emmintrin.h>
+#if defined(__GNUC__) && !defined(DECODE_NOAVX2)
+#define DECODE_AVX2
+#include <immintrin.h>
+#endif
+#elif !defined(DECODE_SCALAR) && defined(__ARM_NEON)
+#define DECODE_NEON
+#include <arm_neon.h>
+#endif
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+/*Odd parity check and flags of an angle word*/
+static uint8_t angleFlags(uint16_t word)
+{
+	uint16_t p = word;
+
+	p ^= p >> 8;
+	p ^= p >> 4;
+	p ^= p >> 2;
+	p ^= p >> 1;
+
+	return (uint8_t)(((p & 0x0001) ^ 0x0001) | ((word >> 13) & DECODE_EF) | ((word >> 11) & DECODE_NF));
+}
+
+static void anglesScalar(const uint16_t words[], float angles[], uint8_t flags[], size_t i, size_t n)
+{
+	uint8_t f;
+
+	for(; i < n; i++)
+	{
+		f = angleFlags(words[i]);
+		angles[i] = (f & DECODE_PARITY) ? (float)ERROR : (float)((words[i] & 0x0FFF) * 360.0 / 4096.0);
+		if(flags != NULL)
+			flags[i] = f;
+	}
+}
+
+#ifdef DECODE_X86
+
+static size_t anglesSSE2(const uint16_t words[], float angles[], uint8_t flags[], size_t n)
+{
+	const __m128i mask = _mm_set1_epi16(0x0FFF), one = _mm_set1_epi16(0x0001), zero = _mm_setzero_si128();
+	const __m128i ef = _mm_set1_epi16(DECODE_EF), nf = _mm_set1_epi16(DECODE_NF);
+	const __m128 scale = _mm_set1_ps(45.0f), shift = _mm_set1_ps(1.0f / 512.0f), error = _mm_set1_ps((float)ERROR);
+	__m128i v, p, valid, f, x;
+	__m128 a, m;
+	size_t i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		v = _mm_loadu_si128((const __m128i *)&words[i]);
+
+		/*Parity of the 16 bits folded into bit 0*/
+		p = _mm_xor_si128(v, _mm_srli_epi16(v, 8));
+		p = _mm_xor_si128(p, _mm_srli_epi16(p, 4));
+		p = _mm_xor_si128(p, _mm_srli_epi16(p, 2));
+		p = _mm_xor_si128(p, _mm_srli_epi16(p, 1));
+		p = _mm_and_si128(p, one);
+		valid = _mm_cmpeq_epi16(p, one);
+
+		/*Angles of the low and high 4 words*/
+		x = _mm_and_si128(v, mask);
+
+		a = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), scale), shift);
+		m = _mm_castsi128_ps(_mm_unpacklo_epi16(valid, valid));
+		_mm_storeu_ps(&angles[i], _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, error)));
+
+		a = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), scale), shift);
+		m = _mm_castsi128_ps(_mm_unpackhi_epi16(valid, valid));
+		_mm_storeu_ps(&angles[i + 4], _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, error)));
+
+		if(flags != NULL)
+		{
+			f = _mm_xor_si128(p, one);
+			f = _mm_or_si128(f, _mm_and_si128(_mm_srli_epi16(v, 13), ef));
+			f = _mm_or_si128(f, _mm_and_si128(_mm_srli_epi16(v, 11), nf));
+			_mm_storel_epi64((__m128i *)&flags[i], _mm_packus_epi16(f, zero));
+		}
+	}
+
+	return i;
+}
+
+static size_t tempsSSE2(const uint16_t words[], float temps[], size_t n)
+{
+	const __m128i mask = _mm_set1_epi16(0x0FFF), zero = _mm_setzero_si128();
+	const __m128d eighth = _mm_set1_pd(0.125), offset = _mm_set1_pd(273.16);
+	__m128i x;
+	__m128d t;
+	size_t i;
+
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		x = _mm_unpacklo_epi16(_mm_and_si128(_mm_loadl_epi64((const __m128i *)&words[i]), mask), zero);
+
+		t = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(x), eighth), offset);
+		_mm_storel_pi((__m64 *)&temps[i], _mm_cvtpd_ps(t));
+
+		t = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), eighth), offset);
+		_mm_storel_pi((__m64 *)&temps[i + 2], _mm_cvtpd_ps(t));
+	}
+
+	return i;
+}
+
+static size_t fieldsSSE2(const uint16_t words[], float fields[], float scale, size_t n)
+{
+	const __m128i mask = _mm_set1_epi16(0x0FFF), zero = _mm_setzero_si128();
+	const __m128 s = _mm_set1_ps(scale);
+	__m128i x;
+	size_t i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		x = _mm_and_si128(_mm_loadu_si128((const __m128i *)&words[i]), mask);
+		_mm_storeu_ps(&fields[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), s));
+		_mm_storeu_ps(&fields[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), s));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef DECODE_AVX2
+
+__attribute__((target("avx2")))
+static size_t anglesAVX2(const uint16_t words[], float angles[], uint8_t flags[], size_t n)
+{
+	const __m256i mask = _mm256_set1_epi16(0x0FFF), one = _mm256_set1_epi16(0x0001);
+	const __m256i ef = _mm256_set1_epi16(DECODE_EF), nf = _mm256_set1_epi16(DECODE_NF);
+	const __m256 scale = _mm256_set1_ps(45.0f), shift = _mm256_set1_ps(1.0f / 512.0f), error = _mm256_set1_ps((float)ERROR);
+	__m256i v, p, valid, f, x;
+	__m256 a;
+	size_t i;
+
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		v = _mm256_loadu_si256((const __m256i *)&words[i]);
+
+		/*Parity of the 16 bits folded into bit 0*/
+		p = _mm256_xor_si256(v, _mm256_srli_epi16(v, 8));
+		p = _mm256_xor_si256(p, _mm256_srli_epi16(p, 4));
+		p = _mm256_xor_si256(p, _mm256_srli_epi16(p, 2));
+		p = _mm256_xor_si256(p, _mm256_srli_epi16(p, 1));
+		p = _mm256_and_si256(p, one);
+		valid = _mm256_cmpeq_epi16(p, one);
+
+		/*Angles of the low and high 8 words*/
+		x = _mm256_and_si256(v, mask);
+
+		a = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(x))), scale), shift);
+		a = _mm256_blendv_ps(error, a, _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(valid))));
+		_mm256_storeu_ps(&angles[i], a);
+
+		a = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(x, 1))), scale), shift);
+		a = _mm256_blendv_ps(error, a, _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(valid, 1))));
+		_mm256_storeu_ps(&angles[i + 8], a);
+
+		if(flags != NULL)
+		{
+			f = _mm256_xor_si256(p, one);
+			f = _mm256_or_si256(f, _mm256_and_si256(_mm256_srli_epi16(v, 13), ef));
+			f = _mm256_or_si256(f, _mm256_and_si256(_mm256_srli_epi16(v, 11), nf));
+			_mm_storeu_si128((__m128i *)&flags[i], _mm_packus_epi16(_mm256_castsi256_si128(f), _mm256_extracti128_si256(f, 1)));
+		}
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t tempsAVX2(const uint16_t words[], float temps[], size_t n)
+{
+	const __m128i mask = _mm_set1_epi16(0x0FFF);
+	const __m256d eighth = _mm256_set1_pd(0.125), offset = _mm256_set1_pd(273.16);
+	__m256d t;
+	size_t i;
+
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		t = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_and_si128(_mm_loadl_epi64((const __m128i *)&words[i]), mask)));
+		t = _mm256_sub_pd(_mm256_mul_pd(t, eighth), offset);
+		_mm_storeu_ps(&temps[i], _mm256_cvtpd_ps(t));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef DECODE_NEON
+
+static size_t anglesNEON(const uint16_t words[], float angles[], uint8_t flags[], size_t n)
+{
+	const uint16x8_t mask = vdupq_n_u16(0x0FFF), one = vdupq_n_u16(0x0001);
+	const uint16x8_t ef = vdupq_n_u16(DECODE_EF), nf = vdupq_n_u16(DECODE_NF);
+	const float32x4_t error = vdupq_n_f32((float)ERROR);
+	uint16x8_t v, p, valid, f, x;
+	float32x4_t a;
+	size_t i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		v = vld1q_u16(&words[i]);
+
+		/*Parity of the 16 bits folded into bit 0*/
+		p = veorq_u16(v, vshrq_n_u16(v, 8));
+		p = veorq_u16(p, vshrq_n_u16(p, 4));
+		p = veorq_u16(p, vshrq_n_u16(p, 2));
+		p = veorq_u16(p, vshrq_n_u16(p, 1));
+		p = vandq_u16(p, one);
+		valid = vceqq_u16(p, one);
+
+		/*Angles of the low and high 4 words*/
+		x = vandq_u16(v, mask);
+
+		a = vmulq_n_f32(vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(x))), 45.0f), 1.0f / 512.0f);
+		vst1q_f32(&angles[i], vbslq_f32(vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_low_u16(valid)))), a, error));
+
+		a = vmulq_n_f32(vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(x))), 45.0f), 1.0f / 512.0f);
+		vst1q_f32(&angles[i + 4], vbslq_f32(vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_high_u16(valid)))), a, error));
+
+		if(flags != NULL)
+		{
+			f = veorq_u16(p, one);
+			f = vorrq_u16(f, vandq_u16(vshrq_n_u16(v, 13), ef));
+			f = vorrq_u16(f, vandq_u16(vshrq_n_u16(v, 11), nf));
+			vst1_u8(&flags[i], vmovn_u16(f));
+		}
+	}
+
+	return i;
+}
+
+static size_t tempsNEON(const uint16_t words[], float temps[], size_t n)
+{
+	size_t i = 0;
+
+#if defined(__aarch64__)
+	const uint16x4_t mask = vdup_n_u16(0x0FFF);
+	const float64x2_t offset = vdupq_n_f64(273.16);
+	uint32x4_t x;
+	float64x2_t t;
+
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		x = vmovl_u16(vand_u16(vld1_u16(&words[i]), mask));
+
+		t = vsubq_f64(vmulq_n_f64(vcvtq_f64_u64(vmovl_u32(vget_low_u32(x))), 0.125), offset);
+		vst1_f32(&temps[i], vcvt_f32_f64(t));
+
+		t = vsubq_f64(vmulq_n_f64(vcvtq_f64_u64(vmovl_u32(vget_high_u32(x))), 0.125), offset);
+		vst1_f32(&temps[i + 2], vcvt_f32_f64(t));
+	}
+#endif
+
+	return i;
+}
+
+static size_t fieldsNEON(const uint16_t words[], float fields[], float scale, size_t n)
+{
+	const uint16x8_t mask = vdupq_n_u16(0x0FFF);
+	uint16x8_t x;
+	size_t i;
+
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		x = vandq_u16(vld1q_u16(&words[i]), mask);
+		vst1q_f32(&fields[i], vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(x))), scale));
+		vst1q_f32(&fields[i + 4], vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(x))), scale));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef DECODE_AVX2
+static int hasAVX2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+void DecodeAngles(const uint16_t words[], float angles[], uint8_t flags[], size_t n)
+{
+	size_t i = 0;
+
+#if defined(DECODE_AVX2)
+	if(hasAVX2())
+		i = anglesAVX2(words, angles, flags, n);
+	else
+		i = anglesSSE2(words, angles, flags, n);
+#elif defined(DECODE_X86)
+	i = anglesSSE2(words, angles, flags, n);
+#elif defined(DECODE_NEON)
+	i = anglesNEON(words, angles, flags, n);
+#endif
+
+	anglesScalar(words, angles, flags, i, n);
+}
+
+void DecodeTemps(const uint16_t words[], float temps[], size_t n)
+{
+	size_t i = 0;
+
+#if defined(DECODE_AVX2)
+	if(hasAVX2())
+		i = tempsAVX2(words, temps, n);
+	else
+		i = tempsSSE2(words, temps, n);
+#elif defined(DECODE_X86)
+	i = tempsSSE2(words, temps, n);
+#elif defined(DECODE_NEON)
+	i = tempsNEON(words, temps, n);
+#endif
+
+	for(; i < n; i++)
+		temps[i] = decodeTemp(words[i]);
+}
+
+void DecodeTempsKelvin(const uint16_t words[], float temps[], size_t n)
+{
+	size_t i = 0;
+
+	/*(word & 0x0FFF) / 8 is exact in float*/
+#if defined(DECODE_X86)
+	i = fieldsSSE2(words, temps, 0.125f, n);
+#elif defined(DECODE_NEON)
+	i = fieldsNEON(words, temps, 0.125f, n);
+#endif
+
+	for(; i < n; i++)
+		temps[i] = (float)((words[i] & 0x0FFF) / 8.0);
+}
+
+void DecodeFields(const uint16_t words[], float fields[], size_t n)
+{
+	size_t i = 0;
+
+#if defined(DECODE_X86)
+	i = fieldsSSE2(words, fields, 1.0f, n);
+#elif defined(DECODE_NEON)
+	i = fieldsNEON(words, fields, 1.0f, n);
+#endif
+
+	for(; i < n; i++)
+		fields[i] = decodeField(words[i]);
+}
+
+const char *DecodeKernel(void)
+{
+#if defined(DECODE_AVX2)
+	if(hasAVX2())
+		return "AVX2";
+#endif
+#if defined(DECODE_X86)
+	return "SSE2";
+#elif defined(DECODE_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
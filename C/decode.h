@@ -0,0 +1,31 @@
+#ifndef DECODE_H__
+#define DECODE_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+/*Flags of a decoded angle word*/
+#define DECODE_PARITY 0x01		//Parity error (the angle is (float)ERROR as in decodeAngle())
+#define DECODE_EF 0x02			//Error Flag set in the angle register
+#define DECODE_NF 0x04			//New Flag set in the angle register
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void DecodeAngles(const uint16_t words[], float angles[], uint8_t flags[], size_t n);
+void DecodeTemps(const uint16_t words[], float temps[], size_t n);
+void DecodeTempsKelvin(const uint16_t words[], float temps[], size_t n);
+void DecodeFields(const uint16_t words[], float fields[], size_t n);
+const char *DecodeKernel(void);
+
+#endif
@@ -0,0 +1,177 @@
+/*******************************************************
+
+	University of Udine
+
+	Bit exactness check of the batch decoding
+	kernels of the Allegro A1335 library
+
+	Authors:
+	- Alessandro Fornasier
+
+	Requisites:
+	- WiringPi library
+
+	Compiling:
+	cc -O2 -o decode_check decode_check.c decode.c angle.c spi.c metrics.c shadow.c -lwiringPi
+	cc -O2 -DDECODE_NOAVX2 -o decode_check_sse2 decode_check.c decode.c angle.c spi.c metrics.c shadow.c -lwiringPi
+	cc -O2 -DDECODE_SCALAR -o decode_check_scalar decode_check.c decode.c angle.c spi.c metrics.c shadow.c -lwiringPi
+
+	Notes:
+	Every 16 bit word goes through DecodeAngles(),
+	DecodeTemps(), DecodeTempsKelvin() and
+	DecodeFields(), compared bit by bit with
+	decodeAngle() (and the parity, EF and NF flags),
+	decodeTemp(), the Kelvin value and decodeField().
+	The batches start at every offset of an unaligned
+	input and output (0:7 elements) and take every
+	length up to 64, so the vector loops and the
+	scalar remainder are both covered. The kernel
+	checked is the one selected at run time (AVX2 on
+	an AVX2 host, SSE2 otherwise or with -DDECODE_NOAVX2,
+	NEON on ARM, scalar with -DDECODE_SCALAR): build
+	the variants above to check each. Exit 1 on the
+	first mismatch.
+
+*******************************************************/
+
+/*******************************************************
+
+	Library:
+
+*******************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "angle.h"
+#include "decode.h"
+
+/*******************************************************
+
+	Definitions:
+
+*******************************************************/
+
+#define CHECK_WORDS 65536		//Every 16 bit word
+#define CHECK_OFFSETS 8			//Offsets of the unaligned batches (elements)
+#define CHECK_LENGTHS 64		//Max length of the short batches
+
+/*******************************************************
+
+	Variables:
+
+*******************************************************/
+
+static uint16_t words[CHECK_WORDS + CHECK_OFFSETS];
+static float values[CHECK_WORDS + CHECK_OFFSETS];
+static uint8_t flags[CHECK_WORDS + CHECK_OFFSETS];
+static float expectedAngle[CHECK_WORDS], expectedTemp[CHECK_WORDS], expectedKelvin[CHECK_WORDS], expectedField[CHECK_WORDS];
+static uint8_t expectedFlags[CHECK_WORDS];
+
+/*******************************************************
+
+	Functions:
+
+*******************************************************/
+
+static void expected(void)
+{
+	uint16_t count;
+	uint32_t w;
+
+	for(w = 0; w < CHECK_WORDS; w++)
+	{
+		expectedAngle[w] = decodeAngle((uint16_t)w);
+		expectedTemp[w] = decodeTemp((uint16_t)w);
+		expectedKelvin[w] = (float)((w & 0x0FFF) / 8.0);
+		expectedField[w] = decodeField((uint16_t)w);
+		expectedFlags[w] = ((decodeAngleCount((uint16_t)w, &count) == PARITYERROR) ? DECODE_PARITY : 0)
+			| ((w & ANGLE_EF) ? DECODE_EF : 0) | ((w & ANGLE_NF) ? DECODE_NF : 0);
+	}
+}
+
+/*Batch of n words from first, input at offset in and output at offset out, NOERROR if bit exact*/
+static int check(const char *name, uint32_t first, size_t n, size_t in, size_t out)
+{
+	const float *reference;
+	size_t i;
+
+	for(i = 0; i < n; i++)
+		words[in + i] = (uint16_t)(first + i);
+
+	if(strcmp(name, "angle") == 0)
+	{
+		DecodeAngles(&words[in], &values[out], &flags[out], n);
+		reference = expectedAngle;
+	}
+	else if(strcmp(name, "temperature") == 0)
+	{
+		DecodeTemps(&words[in], &values[out], n);
+		reference = expectedTemp;
+	}
+	else if(strcmp(name, "kelvin") == 0)
+	{
+		DecodeTempsKelvin(&words[in], &values[out], n);
+		reference = expectedKelvin;
+	}
+	else
+	{
+		DecodeFields(&words[in], &values[out], n);
+		reference = expectedField;
+	}
+
+	for(i = 0; i < n; i++)
+	{
+		if(memcmp(&values[out + i], &reference[first + i], sizeof(float)) != 0)
+		{
+			printf("%s mismatch: word 0x%04X (offsets %zu/%zu, length %zu) %.9g != %.9g\n", name, (unsigned int)(first + i), in, out, n, values[out + i], reference[first + i]);
+			return ERROR;
+		}
+
+		if((strcmp(name, "angle") == 0) && (flags[out + i] != expectedFlags[first + i]))
+		{
+			printf("angle flags mismatch: word 0x%04X (offsets %zu/%zu, length %zu) 0x%02X != 0x%02X\n", (unsigned int)(first + i), in, out, n, flags[out + i], expectedFlags[first + i]);
+			return ERROR;
+		}
+	}
+
+	return NOERROR;
+}
+
+/*******************************************************
+
+	Main function:
+
+*******************************************************/
+
+int main(void)
+{
+	static const char *names[] = {"angle", "temperature", "kelvin", "field"};
+	size_t in, out, n;
+	uint32_t first;
+	int k;
+
+	expected();
+	printf("kernel: %s\n", DecodeKernel());
+
+	for(k = 0; k < 4; k++)
+	{
+		/*Every word in one batch, at every offset*/
+		for(in = 0; in < CHECK_OFFSETS; in++)
+			if(check(names[k], 0, CHECK_WORDS, in, (CHECK_OFFSETS - in) % CHECK_OFFSETS) == ERROR)
+				return 1;
+
+		/*Short batches: vector loop plus remainder of every length*/
+		for(n = 0; n <= CHECK_LENGTHS; n++)
+			for(in = 0; in < CHECK_OFFSETS; in++)
+				for(out = 0; out < CHECK_OFFSETS; out++)
+					for(first = 0; first + n <= CHECK_WORDS; first += 4099)
+						if(check(names[k], first, n, in, out) == ERROR)
+							return 1;
+
+		printf("%-12s ok\n", names[k]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,470 @@
+/*******************************************
+
+	University of Udine
+
+	Software model of the Allegro A1335
+	serial interface
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Frames are [15:14] R/W code, [13:8] register address, [7:0] data
+	- Each frame returns the result of the previous command (one frame response lag)
+	- A Read command of an even address returns the full 16 bit register, of an odd address the
+	  single byte with the 8 MSB at 0
+	- A Write command writes a single byte
+	- Primary registers: angle 0x20, status 0x22, XERR 0x26, temperature 0x28, field 0x2A and CTRL
+	  0x1E:0x1F (idle and run with the key 0x46 written last, soft 0x16 and hard 0x32 reset with the
+	  key 0xB9 written first)
+	- The angle register 0x20:0x21 carries odd parity on bit 12 (as checked by getAngle()), the new
+	  angle flag is set every refresh time and cleared when the angle is read, the error flag is
+	  set while XERR is not 0 (EmulatorSetError(), a write of 1 clears an XERR bit)
+	- The magnet turns at the speed set by EmulatorSetSpeed(), the angle is sampled every refresh
+	  time
+	- Extended SRAM (0x0000:0x001F) and EEPROM (0x0300:0x031F) are stored, the writes and reads
+	  complete after EMULATOR_SRAM_LATENCY or EMULATOR_EEPROM_LATENCY: WDN and RDN stay at 0 until
+	  then. A reset reloads the SRAM with its power on content (zeros, the EEPROM to SRAM mapping
+	  of the device is not modelled) and keeps the EEPROM
+	- An extended write of ORATE (address 0xFFD0) sets the refresh time (32us * 2^ORATE)
+	- Real time (micros(), read once per transfer) by default; EmulatorSetFrameTime() moves the
+	  time by the bus time of each frame instead: no clock reads, results independent of the host
+	- With the CRC framing (EmulatorSetCRC(), as the sensor configured for it) the CRC of every
+	  frame is checked, a command with a wrong CRC is ignored (the previous result is returned
+	  again), and every response carries its CRC in the 4 MSB of the third byte
+	- Above the clock set by EmulatorSetMaxClock() (the SPI clock of the chip select, SPIgetSpeed())
+	  a bit of the response is flipped in a share of the frames growing with the excess: 10% over
+	  the limit breaks about 10% of the frames, twice the limit every frame (for calibrate.c)
+	- Use EmulatorTransfer() as transport (SPIsetTransport(EmulatorTransfer, &emu)) to run the
+	  library without the sensor, or EmulatorBusTransfer() with one emulator bound to each chip
+	  select (EmulatorBind())
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <wiringPi.h>
+#include "angle.h"
+#include "spi.h"
+#include "emulator.h"
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static A1335emulator *bound[SPI_MAX_DEVICES];		//Emulators of EmulatorBusTransfer()
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static inline uint16_t getWord(A1335emulator *emu, uint8_t address)
+{
+	address &= 0xFE;
+	return ((uint16_t)emu->primary[address] << 8) + (uint16_t)emu->primary[address + 1];
+}
+
+static inline void setWord(A1335emulator *emu, uint8_t address, uint16_t word)
+{
+	address &= 0xFE;
+	emu->primary[address] = (uint8_t)(word >> 8);
+	emu->primary[address + 1] = (uint8_t)(word & 0x00FF);
+}
+
+static inline void setAngleWord(A1335emulator *emu, uint16_t word)
+{
+	uint16_t parity;
+
+	/*Error flag while an error is reported in XERR*/
+	word &= ~(ANGLE_P | ANGLE_EF);
+	if(getWord(emu, 0x26) != 0)
+		word |= ANGLE_EF;
+
+	/*Set the parity bit to obtain an odd number of ones*/
+	parity = word ^ (word >> 8);
+	parity ^= parity >> 4;
+	parity ^= parity >> 2;
+	parity ^= parity >> 1;
+
+	if((parity & 0x0001) == 0)
+		word |= ANGLE_P;
+
+	setWord(emu, 0x20, word);
+}
+
+static inline uint16_t magnetCount(A1335emulator *emu)
+{
+	/*12 bits of the 32 bit phase*/
+	return (uint16_t)(emu->phase >> 20);
+}
+
+static inline int isEEPROM(uint16_t address)
+{
+	return (address >= EMULATOR_EEPROM_BASE) && (address < EMULATOR_EEPROM_BASE + EMULATOR_EEPROM_SIZE);
+}
+
+static void completeWrite(A1335emulator *emu)
+{
+	uint16_t address = ((uint16_t)emu->primary[0x02] << 8) + (uint16_t)emu->primary[0x03];
+	uint32_t value = ((uint32_t)emu->primary[0x04] << 24) + ((uint32_t)emu->primary[0x05] << 16) + ((uint32_t)emu->primary[0x06] << 8) + (uint32_t)emu->primary[0x07];
+
+	if(address < EMULATOR_EXTENDED_SIZE)
+		emu->extended[address] = value;
+	else if(isEEPROM(address))
+		emu->eeprom[address - EMULATOR_EEPROM_BASE] = value;
+
+	/*ORATE (extended address 0xFFD0): new refresh time*/
+	if((address == 0xFFD0) && ((value & 0x0F) <= ORATE_MAX))
+		emu->refresh = (uint32_t)ORATE_SAMPLE << (value & 0x0F);
+
+	/*Done: EXW cleared, WDN set*/
+	emu->primary[0x08] = 0x00;
+	emu->primary[0x09] = 0x01;
+}
+
+static void completeRead(A1335emulator *emu)
+{
+	uint16_t address = ((uint16_t)emu->primary[0x0A] << 8) + (uint16_t)emu->primary[0x0B];
+	uint32_t value = 0x00000000;
+
+	if(address < EMULATOR_EXTENDED_SIZE)
+		value = emu->extended[address];
+	else if(isEEPROM(address))
+		value = emu->eeprom[address - EMULATOR_EEPROM_BASE];
+
+	emu->primary[0x0E] = (uint8_t)(value >> 24);
+	emu->primary[0x0F] = (uint8_t)(value >> 16);
+	emu->primary[0x10] = (uint8_t)(value >> 8);
+	emu->primary[0x11] = (uint8_t)value;
+
+	/*Done: EXR cleared, RDN set*/
+	emu->primary[0x0C] = 0x00;
+	emu->primary[0x0D] = 0x01;
+}
+
+static void startExtended(A1335emulator *emu, int operation, uint32_t latency)
+{
+	emu->pending = operation;
+	emu->pendingStart = emu->now;
+	emu->pendingLatency = latency;
+
+	/*WDN or RDN cleared until done*/
+	if(operation == EMULATOR_WRITING)
+		emu->primary[0x09] = 0x00;
+	else
+		emu->primary[0x0D] = 0x00;
+}
+
+/*State at the time of the frame: angle refresh and extended operation in progress*/
+static inline void advance(A1335emulator *emu)
+{
+	uint32_t elapsed;
+
+	/*New angle available after the refresh time (the updates keep the sensor own cadence)*/
+	elapsed = emu->now - emu->lastSample;
+	if(elapsed >= emu->refresh)
+	{
+		elapsed -= elapsed % emu->refresh;
+		emu->lastSample += elapsed;
+		emu->phase += (uint32_t)(emu->velocity * (int64_t)elapsed / 1000000);
+		setAngleWord(emu, ANGLE_NF | magnetCount(emu));
+	}
+
+	if((emu->pending != EMULATOR_IDLE) && ((uint32_t)(emu->now - emu->pendingStart) >= emu->pendingLatency))
+	{
+		if(emu->pending == EMULATOR_WRITING)
+			completeWrite(emu);
+		else
+			completeRead(emu);
+
+		emu->pending = EMULATOR_IDLE;
+	}
+}
+
+static void reset(A1335emulator *emu, int hard)
+{
+	uint16_t temp = getWord(emu, 0x28), field = getWord(emu, 0x2A);
+
+	/*The hard reset clears the serial registers too*/
+	if(hard)
+		memset(emu->primary, 0, sizeof(emu->primary));
+
+	memset(emu->extended, 0, sizeof(emu->extended));
+	emu->pending = EMULATOR_IDLE;
+	emu->primary[0x08] = 0x00;
+	emu->primary[0x09] = 0x01;
+	emu->primary[0x0C] = 0x00;
+	emu->primary[0x0D] = 0x01;
+	emu->primary[0x1E] = 0x00;
+	emu->primary[0x1F] = 0x00;
+
+	/*Power on state: run, no errors, default ORATE*/
+	setWord(emu, 0x22, 0x8011);
+	setWord(emu, 0x26, 0x0000);
+	setWord(emu, 0x28, temp);
+	setWord(emu, 0x2A, field);
+	emu->refresh = (uint32_t)ORATE_SAMPLE << ORATE;
+	emu->lastSample = emu->now;
+	setAngleWord(emu, ANGLE_NF | magnetCount(emu));
+}
+
+static inline uint16_t exchange(A1335emulator *emu, uint16_t frame)
+{
+	uint16_t response = emu->response;
+	uint8_t address = (uint8_t)((frame >> 8) & 0x3F);
+	uint8_t data = (uint8_t)(frame & 0x00FF);
+
+	advance(emu);
+
+	if((frame & 0xC000) == ((uint16_t)W << 8))
+	{
+		/*Write command: single byte (XERR: write 1 to clear)*/
+		if((address == 0x26) || (address == 0x27))
+		{
+			emu->primary[address] &= ~data;
+			setAngleWord(emu, getWord(emu, 0x20));
+		}
+		else
+			emu->primary[address] = data;
+
+		emu->response = getWord(emu, address);
+
+		switch(address)
+		{
+			case 0x08:
+				/*Extended write executed (EXW in EWCS): EWD into the address in EWA*/
+				if(data == 0x80)
+					startExtended(emu, EMULATOR_WRITING, isEEPROM(((uint16_t)emu->primary[0x02] << 8) + (uint16_t)emu->primary[0x03]) ? EMULATOR_EEPROM_LATENCY : EMULATOR_SRAM_LATENCY);
+				break;
+
+			case 0x0C:
+				/*Extended read executed (EXR in ERCS): the address in ERA into ERD*/
+				if(data == 0x80)
+					startExtended(emu, EMULATOR_READING, EMULATOR_SRAM_LATENCY);
+				break;
+
+			case 0x1E:
+				/*Reset command in CTRL, executed when the key 0xB9 has been written first*/
+				if((emu->primary[0x1F] == 0xB9) && ((data == 0x16) || (data == 0x32)))
+					reset(emu, data == 0x32);
+				break;
+
+			case 0x1F:
+				/*Processor state command in CTRL, executed when the key 0x46 is written*/
+				if(data == 0x46)
+				{
+					if(emu->primary[0x1E] == 0x80)
+						emu->primary[0x23] = STATE_IDLE;
+					else if(emu->primary[0x1E] == 0xC0)
+						emu->primary[0x23] = STATE_RUN;
+				}
+				break;
+		}
+
+		/*Operations with no latency are done at once*/
+		advance(emu);
+	}
+	else if(address & 0x01)
+	{
+		/*Read command of an odd address: single byte*/
+		emu->response = (uint16_t)emu->primary[address];
+	}
+	else
+	{
+		/*Read command of an even address: full register*/
+		emu->response = getWord(emu, address);
+
+		/*Reading the angle clears the new angle flag*/
+		if(address == 0x20)
+			setAngleWord(emu, emu->response & ~ANGLE_NF);
+	}
+
+	return response;
+}
+
+/*Threshold of the bit errors at the clock of cs (of 2^32 frames), 0 = none*/
+static inline uint32_t errorThreshold(A1335emulator *emu, int cs)
+{
+	uint32_t clock;
+
+	if(emu->maxClock == 0)
+		return 0;
+
+	clock = SPIgetSpeed(cs);
+	if(clock <= emu->maxClock)
+		return 0;
+	if(clock >= 2 * emu->maxClock)
+		return UINT32_MAX;
+
+	return (uint32_t)((uint64_t)(clock - emu->maxClock) * 4294967295ULL / emu->maxClock);
+}
+
+/*xorshift32*/
+static inline uint32_t noise(A1335emulator *emu)
+{
+	emu->noise ^= emu->noise << 13;
+	emu->noise ^= emu->noise >> 17;
+	emu->noise ^= emu->noise << 5;
+
+	return emu->noise;
+}
+
+/*Time of the next frame*/
+static inline void tick(A1335emulator *emu)
+{
+	if(emu->frameTime != 0)
+	{
+		emu->virtualTime += emu->frameTime;
+		emu->now = (uint32_t)(emu->virtualTime / 1000ULL);
+	}
+}
+
+void EmulatorInit(A1335emulator *emu)
+{
+	memset(emu, 0, sizeof(A1335emulator));
+
+	/*Real time*/
+	emu->now = micros();
+
+	/*Power on state, new angle every 4 ms (ORATE = 7)*/
+	EmulatorSetTemp(emu, 25.0);
+	EmulatorSetField(emu, 500);
+	reset(emu, 1);
+}
+
+void EmulatorSetAngle(A1335emulator *emu, float angle)
+{
+	while(angle < 0.0)
+		angle += 360.0;
+
+	emu->phase = (uint32_t)((uint16_t)(angle * 4096.0 / 360.0) & 0x0FFF) << 20;
+	setAngleWord(emu, ANGLE_NF | magnetCount(emu));
+}
+
+void EmulatorSetSpeed(A1335emulator *emu, float speed)
+{
+	/*Degrees per second into turn / 2^32 per second*/
+	emu->velocity = (int64_t)((double)speed / 360.0 * 4294967296.0);
+}
+
+void EmulatorSetTemp(A1335emulator *emu, float temp)
+{
+	setWord(emu, 0x28, 0xF000 | ((uint16_t)((temp + 273.16) * 8.0) & 0x0FFF));
+}
+
+void EmulatorSetField(A1335emulator *emu, uint16_t field)
+{
+	setWord(emu, 0x2A, 0xE000 | (field & 0x0FFF));
+}
+
+void EmulatorSetError(A1335emulator *emu, uint16_t xerr)
+{
+	setWord(emu, 0x26, xerr);
+	setAngleWord(emu, getWord(emu, 0x20));
+}
+
+void EmulatorSetFrameTime(A1335emulator *emu, uint32_t ns)
+{
+	emu->frameTime = ns;
+
+	/*Time from 0, the refresh and the operation in progress restart*/
+	emu->virtualTime = 0;
+	emu->now = (ns != 0) ? 0 : micros();
+	emu->lastSample = emu->now;
+	emu->pendingStart = emu->now;
+}
+
+void EmulatorSetCRC(A1335emulator *emu, int enable)
+{
+	emu->crc = (enable != 0);
+	emu->crcErrors = 0;
+}
+
+void EmulatorSetMaxClock(A1335emulator *emu, uint32_t hz)
+{
+	emu->maxClock = hz;
+	emu->noise = 0x2545F491;
+}
+
+uint16_t EmulatorFrame(A1335emulator *emu, uint16_t frame)
+{
+	if(emu->frameTime == 0)
+		emu->now = micros();
+	else
+		tick(emu);
+
+	return exchange(emu, frame);
+}
+
+int EmulatorTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx)
+{
+	A1335emulator *emu = (A1335emulator *)ctx;
+	uint16_t frame, response;
+	uint32_t threshold = errorThreshold(emu, cs);
+	int i;
+
+	/*The frames of a transfer are microseconds apart: one clock reading*/
+	if(emu->frameTime == 0)
+		emu->now = micros();
+
+	for(i = 0; i < n; i++)
+	{
+		tick(emu);
+		frame = ((uint16_t)frames[i][0] << 8) + (uint16_t)frames[i][1];
+
+		if(emu->crc && ((frames[i][2] >> 4) != SPIcrc(frame)))
+		{
+			emu->crcErrors++;
+			response = emu->response;
+		}
+		else
+			response = exchange(emu, frame);
+
+		frames[i][2] = emu->crc ? (uint8_t)(SPIcrc(response) << 4) : 0x00;
+
+		/*Bit error on the way back (after the CRC)*/
+		if((threshold != 0) && (noise(emu) <= threshold))
+			response ^= (uint16_t)(1 << (noise(emu) & 0x0F));
+
+		frames[i][0] = (uint8_t)(response >> 8);
+		frames[i][1] = (uint8_t)(response & 0x00FF);
+	}
+
+	return NOERROR;
+}
+
+int EmulatorBind(int cs, A1335emulator *emu)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	bound[cs] = emu;
+
+	return NOERROR;
+}
+
+int EmulatorBusTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx)
+{
+	/*No sensor on the chip select*/
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES) || (bound[cs] == NULL))
+		return ERROR;
+
+	return EmulatorTransfer(cs, frames, n, bound[cs]);
+}
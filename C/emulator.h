@@ -0,0 +1,86 @@
+#ifndef EMULATOR_H__
+#define EMULATOR_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include "spi.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define EMULATOR_PRIMARY_SIZE 0x40		//Primary serial registers 0x00:0x3F
+#define EMULATOR_EXTENDED_SIZE 0x20		//Extended SRAM addresses 0x0000:0x001F
+#define EMULATOR_EEPROM_BASE 0x0300		//First extended EEPROM address
+#define EMULATOR_EEPROM_SIZE 0x20		//Extended EEPROM addresses 0x0300:0x031F
+#define EMULATOR_SRAM_LATENCY 8			//Time of an extended SRAM write or read (in us)
+#define EMULATOR_EEPROM_LATENCY 5000	//Time of an extended EEPROM write (in us)
+#define EMULATOR_FRAME_TIME 18000		//Bus time of a frame for EmulatorSetFrameTime() (in ns, 16 bits at SPI_CLOCK and the chip select)
+
+/*Extended operation in progress*/
+#define EMULATOR_IDLE 0
+#define EMULATOR_WRITING 1
+#define EMULATOR_READING 2
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Software model of the A1335 serial interface*/
+typedef struct
+{
+	uint8_t primary[EMULATOR_PRIMARY_SIZE];		//Primary serial registers (byte addressed)
+	uint32_t extended[EMULATOR_EXTENDED_SIZE];	//Extended SRAM (32 bit words)
+	uint32_t eeprom[EMULATOR_EEPROM_SIZE];		//Extended EEPROM (32 bit words, kept through the resets)
+	uint16_t response;							//Result of the previous command (one frame response lag)
+
+	/*Time (in us)*/
+	uint32_t frameTime;							//Bus time of a frame (in ns), 0 = real time (micros())
+	uint64_t virtualTime;						//Time of the frames exchanged (in ns, frameTime != 0)
+	uint32_t now;								//Time of the frame in progress
+	uint32_t refresh;							//Time between two angles
+	uint32_t lastSample;						//Time of the last angle
+
+	/*Extended operation*/
+	int pending;								//EMULATOR_IDLE, EMULATOR_WRITING or EMULATOR_READING
+	uint32_t pendingStart;						//Start of the operation
+	uint32_t pendingLatency;					//Duration of the operation
+
+	/*CRC framing*/
+	int crc;									//Frames carry a CRC (EmulatorSetCRC())
+	uint64_t crcErrors;							//Commands with a wrong CRC (ignored)
+
+	/*Signal integrity*/
+	uint32_t maxClock;							//Highest clock without bit errors (in Hz, 0 = any clock)
+	uint32_t noise;								//State of the bit error generator
+
+	/*Magnet*/
+	uint32_t phase;								//Angle of the magnet (2^32 = one turn)
+	int64_t velocity;							//Speed of the magnet (turn / 2^32 per second)
+} A1335emulator;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void EmulatorInit(A1335emulator *emu);
+void EmulatorSetAngle(A1335emulator *emu, float angle);
+void EmulatorSetSpeed(A1335emulator *emu, float speed);
+void EmulatorSetTemp(A1335emulator *emu, float temp);
+void EmulatorSetField(A1335emulator *emu, uint16_t field);
+void EmulatorSetError(A1335emulator *emu, uint16_t xerr);
+void EmulatorSetFrameTime(A1335emulator *emu, uint32_t ns);
+void EmulatorSetCRC(A1335emulator *emu, int enable);
+void EmulatorSetMaxClock(A1335emulator *emu, uint32_t hz);
+uint16_t EmulatorFrame(A1335emulator *emu, uint16_t frame);
+int EmulatorTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx);
+int EmulatorBind(int cs, A1335emulator *emu);
+int EmulatorBusTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx);
+
+#endif
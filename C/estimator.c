@@ -0,0 +1,127 @@
+/*******************************************
+
+	University of Udine
+
+	Multi-turn unwrapping and velocity
+	estimation for the Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- O(1) per sample: the angle count is unwrapped on the shortest way from the previous reading
+	  (the shaft must turn less than half a turn between two samples), then an alpha-beta-gamma
+	  filter tracks position, velocity and acceleration
+	- The unwrapped count is an integer, it does not drift however many turns
+	- The time step is taken from the sample timestamps, so a missed period does not bias the
+	  velocity
+	- gamma = 0 is an alpha-beta filter (the acceleration stays 0), a critically damped alpha-beta
+	  filter has beta = alpha^2 / (2 - alpha)
+	- A reading with a parity error does not update the estimates
+	- Run inside the acquisition thread: the estimates are in the sample published
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "angle.h"
+#include "estimator.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+void EstimatorInit(A1335estimator *estimator, double alpha, double beta, double gamma)
+{
+	estimator->alpha = alpha;
+	estimator->beta = beta;
+	estimator->gamma = gamma;
+
+	EstimatorReset(estimator);
+}
+
+void EstimatorReset(A1335estimator *estimator)
+{
+	estimator->initialized = 0;
+	estimator->lastCount = 0;
+	estimator->lastTime = 0;
+	estimator->estimate.count = 0;
+	estimator->estimate.turns = 0;
+	estimator->estimate.position = 0.0;
+	estimator->estimate.velocity = 0.0;
+	estimator->estimate.acceleration = 0.0;
+}
+
+int EstimatorUpdate(A1335estimator *estimator, uint16_t angleWord, uint64_t timestamp, A1335estimate *estimate)
+{
+	A1335estimate *e = &estimator->estimate;
+	uint16_t count;
+	int delta, result;
+	double dt, x, r;
+
+	if((result = decodeAngleCount(angleWord, &count)) != NOERROR)
+	{
+		*estimate = *e;
+		return result;
+	}
+
+	if(!estimator->initialized)
+	{
+		/*First reading: start at rest in the first turn*/
+		e->count = count;
+		e->position = count * 360.0 / ANGLE_COUNTS;
+		e->velocity = 0.0;
+		e->acceleration = 0.0;
+		estimator->initialized = 1;
+	}
+	else
+	{
+		/*Unwrap on the shortest way*/
+		delta = (int)count - (int)estimator->lastCount;
+		if(delta >= ANGLE_COUNTS / 2)
+			delta -= ANGLE_COUNTS;
+		else if(delta < -ANGLE_COUNTS / 2)
+			delta += ANGLE_COUNTS;
+		e->count += delta;
+
+		/*Prediction*/
+		dt = (double)(timestamp - estimator->lastTime) * 1e-9;
+		x = e->position;
+		if(dt > 0.0)
+		{
+			x += e->velocity * dt + 0.5 * e->acceleration * dt * dt;
+			e->velocity += e->acceleration * dt;
+		}
+
+		/*Correction with the residual of the measurement*/
+		r = e->count * 360.0 / ANGLE_COUNTS - x;
+		e->position = x + estimator->alpha * r;
+		if(dt > 0.0)
+		{
+			e->velocity += estimator->beta * r / dt;
+			e->acceleration += 2.0 * estimator->gamma * r / (dt * dt);
+		}
+	}
+
+	e->turns = (int32_t)floor(e->position / 360.0);
+	estimator->lastCount = count;
+	estimator->lastTime = timestamp;
+	*estimate = *e;
+
+	return NOERROR;
+}
@@ -0,0 +1,59 @@
+#ifndef ESTIMATOR_H__
+#define ESTIMATOR_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+/*Default gains (alpha-beta filter, gamma = 0 disables the acceleration)*/
+#define ESTIMATOR_ALPHA 0.5
+#define ESTIMATOR_BETA 0.1
+#define ESTIMATOR_GAMMA 0.0
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Estimates of a sensor at the time of a sample*/
+typedef struct
+{
+	int64_t count;			//Multi-turn angle count (12 bits per turn, unwrapped)
+	int32_t turns;			//Whole turns of the filtered position
+	double position;		//Filtered multi-turn position (in Degrees)
+	double velocity;		//Filtered velocity (in Degrees/s)
+	double acceleration;	//Filtered acceleration (in Degrees/s^2)
+} A1335estimate;
+
+/*Alpha-beta(-gamma) filter on the unwrapped angle*/
+typedef struct
+{
+	/*Gains*/
+	double alpha;
+	double beta;
+	double gamma;
+
+	/*State*/
+	int initialized;
+	uint16_t lastCount;		//Last angle count (0:4095)
+	uint64_t lastTime;		//Timestamp of the last update (in ns)
+	A1335estimate estimate;
+} A1335estimator;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void EstimatorInit(A1335estimator *estimator, double alpha, double beta, double gamma);
+void EstimatorReset(A1335estimator *estimator);
+int EstimatorUpdate(A1335estimator *estimator, uint16_t angleWord, uint64_t timestamp, A1335estimate *estimate);
+
+#endif
@@ -0,0 +1,101 @@
+/*******************************************************
+
+	University of Udine
+
+	Conversion of an Allegro A1335 binary log to CSV
+
+	Authors:
+	- Alessandro Fornasier
+
+	Compiling:
+	cc -o log2csv log2csv.c
+
+	Notes:
+	The log is written by samplelog.c, the CSV is
+	written to the standard output if no output file
+	is given.
+
+*******************************************************/
+
+/*******************************************************
+
+	Library:
+
+*******************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "samplelog.h"
+
+/*******************************************************
+
+	Main function:
+
+*******************************************************/
+
+int main(int argc, char *argv[])
+{
+	A1335logHeader header;
+	A1335logRecord records[1024];
+	uint64_t remaining;
+	size_t n, i;
+	FILE *in, *out = stdout;
+
+	if((argc != 2) && (argc != 3))
+	{
+		printf("USE: log [csv]\n\n\tlog: binary log written by samplelog.c.\n\tcsv: output file (standard output if not given).\n\n");
+		return 1;
+	}
+
+	if((in = fopen(argv[1], "rb")) == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	if((fread(&header, sizeof(header), 1, in) != 1) || (memcmp(header.magic, SAMPLELOG_MAGIC, sizeof(header.magic)) != 0) ||
+	   (header.version != SAMPLELOG_VERSION) || (header.recordSize != sizeof(A1335logRecord)))
+	{
+		fprintf(stderr, "%s is not a log of this version\n", argv[1]);
+		fclose(in);
+		return 1;
+	}
+
+	if((argc == 3) && ((out = fopen(argv[2], "w")) == NULL))
+	{
+		fprintf(stderr, "Cannot open %s\n", argv[2]);
+		fclose(in);
+		return 1;
+	}
+
+	fprintf(out, "device,timestamp_ns,sequence,error,angle_word,status,temp_word,field_word,angle,temp,field\n");
+
+	/*Only the records counted in the header are complete*/
+	remaining = header.count;
+	while(remaining > 0)
+	{
+		n = fread(records, sizeof(A1335logRecord), (remaining < 1024) ? (size_t)remaining : 1024, in);
+		if(n == 0)
+			break;
+
+		for(i = 0; i < n; i++)
+			fprintf(out, "%u,%" PRIu64 ",%" PRIu32 ",%d,0x%04X,0x%04X,0x%04X,0x%04X,%f,%f,%f\n",
+					records[i].device, records[i].timestamp, records[i].sequence, records[i].error,
+					records[i].angleWord, records[i].status, records[i].tempWord, records[i].fieldWord,
+					records[i].angle, records[i].temp, records[i].field);
+
+		remaining -= n;
+	}
+
+	if(remaining > 0)
+		fprintf(stderr, "%s truncated: %" PRIu64 " records missing\n", argv[1], remaining);
+
+	fclose(in);
+	if(out != stdout)
+		fclose(out);
+
+	return 0;
+}
@@ -0,0 +1,305 @@
+/*******************************************
+
+	University of Udine
+
+	Latency histograms and counters of the
+	Allegro A1335 library
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Every device (cs) has a latency histogram for each operation (transfer, extended write and
+	  read, angle, snapshot) and counters of frames, transfers, WDN/RDN polls, retries, timeouts,
+	  parity errors, CRC errors and failed transfers
+	- Log-linear histograms: values below 2^METRICS_SUB_BITS ns have a bucket each, every power of
+	  2 above is split in 2^METRICS_SUB_BITS linear buckets (relative error below 12.5%), the last
+	  bucket holds anything longer
+	- A sample costs two clock_gettime() (vDSO) and a few relaxed atomic stores, no locks: each
+	  device is updated by the one thread driving it (as for the rest of the library), so the
+	  updates are load and store, not read-modify-write. Readers run at any time
+	- MetricsGet() copies the metrics of a device (each value is consistent, the set is not a
+	  single point in time), MetricsDump() writes count, mean, p50, p90, p99 and max of every
+	  operation used plus the counters
+	- MetricsEnable(0) stops the recording at run time, METRICS_DISABLE compiles the hooks out
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "angle.h"
+#include "metrics.h"
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+typedef struct
+{
+	atomic_uint_fast64_t buckets[METRICS_BUCKETS];
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t sum;
+	atomic_uint_fast64_t max;
+} histogramState;
+
+typedef struct
+{
+	histogramState op[METRICS_OPERATIONS];
+	atomic_uint_fast64_t counter[METRICS_COUNTERS];
+} deviceState;
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static deviceState devices[METRICS_MAX_DEVICES];
+static atomic_int enabled = 1;
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+/*Single writer per device: load and store instead of an atomic add*/
+static inline void add(atomic_uint_fast64_t *value, uint64_t n)
+{
+	atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline int bucketIndex(uint64_t ns)
+{
+	int msb;
+
+	if(ns < (1ULL << METRICS_SUB_BITS))
+		return (int)ns;
+
+	msb = 63 - __builtin_clzll(ns);
+	if(msb - METRICS_SUB_BITS >= METRICS_OCTAVES)
+		return METRICS_BUCKETS - 1;
+
+	/*Octave above the linear range, then the sub-bucket from the bits below the msb*/
+	return ((msb - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) + (int)((ns >> (msb - METRICS_SUB_BITS)) & ((1 << METRICS_SUB_BITS) - 1));
+}
+
+uint64_t MetricsBucketValue(int bucket)
+{
+	int octave, sub;
+
+	if(bucket < (1 << METRICS_SUB_BITS))
+		return (uint64_t)bucket;
+
+	/*Lower bound of the bucket*/
+	octave = (bucket >> METRICS_SUB_BITS) - 1;
+	sub = bucket & ((1 << METRICS_SUB_BITS) - 1);
+
+	return (uint64_t)((1 << METRICS_SUB_BITS) + sub) << octave;
+}
+
+#ifndef METRICS_DISABLE
+uint64_t MetricsTime(void)
+{
+	struct timespec t;
+
+	if(!atomic_load_explicit(&enabled, memory_order_relaxed))
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+void MetricsRecord(int cs, int op, uint64_t start)
+{
+	histogramState *h;
+	uint64_t ns;
+
+	/*Not enabled when the operation started*/
+	if((start == 0) || (cs < 0) || (cs >= METRICS_MAX_DEVICES))
+		return;
+
+	ns = MetricsTime();
+	if(ns == 0)
+		return;
+	ns -= start;
+
+	h = &devices[cs].op[op];
+	add(&h->buckets[bucketIndex(ns)], 1);
+	add(&h->count, 1);
+	add(&h->sum, ns);
+	if(ns > atomic_load_explicit(&h->max, memory_order_relaxed))
+		atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+}
+
+void MetricsCount(int cs, int counter, uint64_t n)
+{
+	if((cs < 0) || (cs >= METRICS_MAX_DEVICES) || !atomic_load_explicit(&enabled, memory_order_relaxed))
+		return;
+
+	add(&devices[cs].counter[counter], n);
+}
+#endif
+
+void MetricsEnable(int enable)
+{
+	atomic_store(&enabled, enable ? 1 : 0);
+}
+
+int MetricsGet(int cs, A1335metrics *metrics)
+{
+	int i, j;
+
+	if((cs < 0) || (cs >= METRICS_MAX_DEVICES))
+		return ERROR;
+
+	for(i = 0; i < METRICS_OPERATIONS; i++)
+	{
+		histogramState *h = &devices[cs].op[i];
+
+		for(j = 0; j < METRICS_BUCKETS; j++)
+			metrics->op[i].buckets[j] = atomic_load_explicit(&h->buckets[j], memory_order_relaxed);
+		metrics->op[i].count = atomic_load_explicit(&h->count, memory_order_relaxed);
+		metrics->op[i].sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+		metrics->op[i].max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	}
+
+	for(i = 0; i < METRICS_COUNTERS; i++)
+		metrics->counter[i] = atomic_load_explicit(&devices[cs].counter[i], memory_order_relaxed);
+
+	return NOERROR;
+}
+
+void MetricsReset(void)
+{
+	int cs, i, j;
+
+	/*Call it while no device is in use, an update in progress may survive*/
+	for(cs = 0; cs < METRICS_MAX_DEVICES; cs++)
+	{
+		for(i = 0; i < METRICS_OPERATIONS; i++)
+		{
+			for(j = 0; j < METRICS_BUCKETS; j++)
+				atomic_store_explicit(&devices[cs].op[i].buckets[j], 0, memory_order_relaxed);
+			atomic_store_explicit(&devices[cs].op[i].count, 0, memory_order_relaxed);
+			atomic_store_explicit(&devices[cs].op[i].sum, 0, memory_order_relaxed);
+			atomic_store_explicit(&devices[cs].op[i].max, 0, memory_order_relaxed);
+		}
+
+		for(i = 0; i < METRICS_COUNTERS; i++)
+			atomic_store_explicit(&devices[cs].counter[i], 0, memory_order_relaxed);
+	}
+}
+
+uint64_t MetricsPercentile(const A1335histogram *histogram, double p)
+{
+	uint64_t rank, seen = 0, low, high;
+	int i;
+
+	if(histogram->count == 0)
+		return 0;
+
+	/*Rank of the percentile, 1 to count*/
+	rank = (uint64_t)(p / 100.0 * (double)histogram->count + 0.5);
+	if(rank < 1)
+		rank = 1;
+	if(rank > histogram->count)
+		rank = histogram->count;
+
+	for(i = 0; i < METRICS_BUCKETS; i++)
+	{
+		seen += histogram->buckets[i];
+		if(seen >= rank)
+		{
+			/*Middle of the bucket, within the max*/
+			low = MetricsBucketValue(i);
+			high = (i < METRICS_BUCKETS - 1) ? MetricsBucketValue(i + 1) : histogram->max + 1;
+			low += (high - low) / 2;
+			return (low < histogram->max) ? low : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+const char *MetricsOperationName(int op)
+{
+	switch(op)
+	{
+		case METRIC_TRANSFER:		return "transfer";
+		case METRIC_EXTENDED_WRITE:	return "extended_write";
+		case METRIC_EXTENDED_READ:	return "extended_read";
+		case METRIC_ANGLE:			return "angle";
+		case METRIC_SNAPSHOT:		return "snapshot";
+	}
+
+	return "unknown";
+}
+
+const char *MetricsCounterName(int counter)
+{
+	switch(counter)
+	{
+		case METRIC_TRANSFERS:		return "transfers";
+		case METRIC_FRAMES:			return "frames";
+		case METRIC_POLLS:			return "polls";
+		case METRIC_RETRIES:		return "retries";
+		case METRIC_TIMEOUTS:		return "timeouts";
+		case METRIC_PARITY:			return "parity_errors";
+		case METRIC_ERRORS:			return "errors";
+		case METRIC_CRC:			return "crc_errors";
+	}
+
+	return "unknown";
+}
+
+void MetricsDump(FILE *fp)
+{
+	A1335metrics metrics;
+	A1335histogram *h;
+	int cs, i;
+
+	/*Only the devices and the operations used*/
+	for(cs = 0; cs < METRICS_MAX_DEVICES; cs++)
+	{
+		MetricsGet(cs, &metrics);
+		if(metrics.counter[METRIC_TRANSFERS] == 0)
+			continue;
+
+		fprintf(fp, "cs %d\n", cs);
+
+		for(i = 0; i < METRICS_OPERATIONS; i++)
+		{
+			h = &metrics.op[i];
+			if(h->count == 0)
+				continue;
+
+			fprintf(fp, "\t%-15s count %" PRIu64 " mean %.0f ns p50 %" PRIu64 " ns p90 %" PRIu64 " ns p99 %" PRIu64 " ns max %" PRIu64 " ns\n",
+				MetricsOperationName(i), h->count, (double)h->sum / (double)h->count,
+				MetricsPercentile(h, 50.0), MetricsPercentile(h, 90.0), MetricsPercentile(h, 99.0), h->max);
+		}
+
+		fprintf(fp, "\t");
+		for(i = 0; i < METRICS_COUNTERS; i++)
+			fprintf(fp, "%s %" PRIu64 "%s", MetricsCounterName(i), metrics.counter[i], (i < METRICS_COUNTERS - 1) ? " " : "\n");
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef METRICS_H__
+#define METRICS_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stdio.h>
+#include "spi.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define METRICS_MAX_DEVICES SPI_MAX_DEVICES		//Chip selects with metrics
+#define METRICS_SUB_BITS 3						//Linear sub-buckets per power of 2 (2^3, max error 12.5%)
+#define METRICS_OCTAVES 28						//Powers of 2 above the linear range (max latency about 2 s)
+#define METRICS_BUCKETS ((METRICS_OCTAVES + 1) << METRICS_SUB_BITS)
+
+/*Operations*/
+#define METRIC_TRANSFER 0			//SPIsubmit()
+#define METRIC_EXTENDED_WRITE 1		//ExtendedWrite(), WDN polling included
+#define METRIC_EXTENDED_READ 2		//ExtendedRead(), RDN polling included
+#define METRIC_ANGLE 3				//getAngleCount() (getAngle(), getAngleQ16())
+#define METRIC_SNAPSHOT 4			//getSnapshot()
+#define METRICS_OPERATIONS 5
+
+/*Counters*/
+#define METRIC_TRANSFERS 0			//Transfers submitted
+#define METRIC_FRAMES 1				//Frames exchanged
+#define METRIC_POLLS 2				//Readings of WDN/RDN
+#define METRIC_RETRIES 3			//Readings of WDN/RDN repeated (operation not done yet)
+#define METRIC_TIMEOUTS 4			//Extended operations timed out (100 ms)
+#define METRIC_PARITY 5				//Angles with a parity error
+#define METRIC_ERRORS 6				//Transfers failed
+#define METRIC_CRC 7				//Responses with a wrong CRC (CRC framing)
+#define METRICS_COUNTERS 8
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Log-linear latency histogram (in ns)*/
+typedef struct
+{
+	uint64_t buckets[METRICS_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+} A1335histogram;
+
+/*Metrics of a device*/
+typedef struct
+{
+	A1335histogram op[METRICS_OPERATIONS];
+	uint64_t counter[METRICS_COUNTERS];
+} A1335metrics;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+#ifndef METRICS_DISABLE
+uint64_t MetricsTime(void);
+void MetricsRecord(int cs, int op, uint64_t start);
+void MetricsCount(int cs, int counter, uint64_t n);
+#else
+/*Hooks compiled out*/
+static inline uint64_t MetricsTime(void) { return 0; }
+static inline void MetricsRecord(int cs, int op, uint64_t start) { (void)cs; (void)op; (void)start; }
+static inline void MetricsCount(int cs, int counter, uint64_t n) { (void)cs; (void)counter; (void)n; }
+#endif
+
+void MetricsEnable(int enable);
+int MetricsGet(int cs, A1335metrics *metrics);
+void MetricsReset(void);
+uint64_t MetricsPercentile(const A1335histogram *histogram, double p);
+uint64_t MetricsBucketValue(int bucket);
+void MetricsDump(FILE *fp);
+const char *MetricsOperationName(int op);
+const char *MetricsCounterName(int counter);
+
+#endif
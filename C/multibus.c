@@ -0,0 +1,190 @@
+/*******************************************
+
+	University of Udine
+
+	Parallel acquisition of Allegro A1335 on
+	many SPI buses
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- One acquisition thread (acquisition.c) per bus, each pinned to its own CPU: the buses are
+	  driven at the same time and the throughput grows with the number of buses
+	- The sensors of the buses other than 0 are mapped with SPIopenDevice() before MultiBusStart(),
+	  the sensors of a bus must all be given to the same worker
+	- Every worker pushes its samples into its own ring (no lock between the workers), the consumer
+	  merges the rings in a single stream ordered by timestamp with MultiBusMerge()
+	- A sample is merged once every other bus has a newer sample or is idle for longer than lag:
+	  a bus without samples may still be reading one older than the others. lag must be longer
+	  than a cycle of the workers (acquisition stats cycleMax), the samples pushed later than that
+	  are merged anyway and counted as late
+	- Stopped workers do not hold back the merge, MultiBusMerge() after MultiBusStop() drains the
+	  rings
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "angle.h"
+#include "multibus.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+void MultiBusInit(A1335multibus *mb)
+{
+	mb->n = 0;
+	mb->lag = MULTIBUS_LAG;
+	mb->last = 0;
+	mb->merged = 0;
+	mb->late = 0;
+}
+
+int MultiBusAdd(A1335multibus *mb, const int cs[], int n, uint64_t period, int cpu)
+{
+	A1335busWorker *bus;
+
+	if(mb->n >= MULTIBUS_MAX_BUSES)
+		return ERROR;
+
+	bus = &mb->buses[mb->n];
+
+	if(AcquisitionInit(&bus->acq, cs, n, period) == ERROR)
+		return ERROR;
+
+	if(RingInit(&bus->ring, MULTIBUS_RING, RING_DROP_OLDEST) == ERROR)
+		return ERROR;
+
+	bus->acq.cpu = cpu;
+	bus->acq.publish = RingPublish;
+	bus->acq.publishCtx = &bus->ring;
+	bus->npending = 0;
+	bus->next = 0;
+
+	return mb->n++;
+}
+
+int MultiBusStart(A1335multibus *mb)
+{
+	int i;
+
+	for(i = 0; i < mb->n; i++)
+	{
+		if(AcquisitionStart(&mb->buses[i].acq) == ERROR)
+		{
+			/*All or none*/
+			while(--i >= 0)
+				AcquisitionStop(&mb->buses[i].acq);
+			return ERROR;
+		}
+	}
+
+	return NOERROR;
+}
+
+void MultiBusStop(A1335multibus *mb)
+{
+	int i;
+
+	for(i = 0; i < mb->n; i++)
+		AcquisitionStop(&mb->buses[i].acq);
+}
+
+/*Oldest sample not merged of a bus, NULL if its ring is empty*/
+static A1335sample *pendingSample(A1335busWorker *bus)
+{
+	if(bus->next == bus->npending)
+	{
+		bus->npending = RingPopBatch(&bus->ring, bus->pending, MULTIBUS_BATCH);
+		bus->next = 0;
+		if(bus->npending == 0)
+			return NULL;
+	}
+
+	return &bus->pending[bus->next];
+}
+
+size_t MultiBusMerge(A1335multibus *mb, A1335sample samples[], size_t max)
+{
+	A1335sample *head[MULTIBUS_MAX_BUSES];
+	uint64_t now, oldest;
+	size_t count = 0;
+	int i, first;
+
+	while(count < max)
+	{
+		/*Time taken before looking at the rings: a sample pushed after the look is older than lag*/
+		now = AcquisitionTime();
+
+		first = -1;
+		for(i = 0; i < mb->n; i++)
+		{
+			head[i] = pendingSample(&mb->buses[i]);
+			if((head[i] != NULL) && ((first < 0) || (head[i]->timestamp < head[first]->timestamp)))
+				first = i;
+		}
+
+		if(first < 0)
+			break;
+
+		/*A running bus without samples may be reading one older than the oldest pending*/
+		oldest = head[first]->timestamp;
+		for(i = 0; i < mb->n; i++)
+			if((head[i] == NULL) && atomic_load_explicit(&mb->buses[i].acq.running, memory_order_relaxed) &&
+			   ((int64_t)(now - oldest) < (int64_t)mb->lag))
+				break;
+
+		if(i < mb->n)
+			break;
+
+		if(oldest < mb->last)
+			mb->late++;
+		else
+			mb->last = oldest;
+
+		samples[count++] = *head[first];
+		mb->buses[first].next++;
+		mb->merged++;
+	}
+
+	return count;
+}
+
+uint64_t MultiBusDropped(A1335multibus *mb)
+{
+	uint64_t dropped = 0;
+	int i;
+
+	for(i = 0; i < mb->n; i++)
+		dropped += RingDropped(&mb->buses[i].ring);
+
+	return dropped;
+}
+
+void MultiBusFree(A1335multibus *mb)
+{
+	int i;
+
+	for(i = 0; i < mb->n; i++)
+		RingFree(&mb->buses[i].ring);
+
+	mb->n = 0;
+}
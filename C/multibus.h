@@ -0,0 +1,65 @@
+#ifndef MULTIBUS_H__
+#define MULTIBUS_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+#include "sample.h"
+#include "acquisition.h"
+#include "ring.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define MULTIBUS_MAX_BUSES 8		//Max number of buses (one worker thread each)
+#define MULTIBUS_RING 4096			//Samples in the ring of a worker (power of 2)
+#define MULTIBUS_BATCH 64			//Samples popped from a ring at a time
+#define MULTIBUS_LAG 2000000		//Default wait for a late sample of an idle bus (in ns)
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Worker of a bus: acquisition thread and its ring*/
+typedef struct
+{
+	A1335acquisition acq;						//Sensors, period, priority and CPU of the worker
+	A1335ring ring;
+	A1335sample pending[MULTIBUS_BATCH];		//Samples popped, not merged yet
+	size_t npending;
+	size_t next;
+} A1335busWorker;
+
+/*Workers of many buses merged in a single stream (declare it static to keep the alignment of the rings)*/
+typedef struct
+{
+	A1335busWorker buses[MULTIBUS_MAX_BUSES];
+	int n;
+	uint64_t lag;			//Max time from a reading to its push (in ns, longer than a cycle of the workers)
+
+	/*Merge*/
+	uint64_t last;			//Timestamp of the last sample merged
+	uint64_t merged;		//Samples merged
+	uint64_t late;			//Samples merged after a newer one (pushed later than lag)
+} A1335multibus;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void MultiBusInit(A1335multibus *mb);
+int MultiBusAdd(A1335multibus *mb, const int cs[], int n, uint64_t period, int cpu);
+int MultiBusStart(A1335multibus *mb);
+void MultiBusStop(A1335multibus *mb);
+size_t MultiBusMerge(A1335multibus *mb, A1335sample samples[], size_t max);
+uint64_t MultiBusDropped(A1335multibus *mb);
+void MultiBusFree(A1335multibus *mb);
+
+#endif
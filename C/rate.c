@@ -0,0 +1,205 @@
+/*******************************************
+
+	University of Udine
+
+	Output rate profiles of the Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The sensor averages 2^ORATE samples of 32us: a new angle every 32us * 2^ORATE, noise
+	  divided by sqrt(2^ORATE)
+	- RateProfile() picks ORATE (and the host averaging) for the reading period of the host:
+		- RATE_LOW_LATENCY: ORATE 0
+		- RATE_BALANCED: the largest ORATE still giving a new angle at every reading
+		- RATE_LOW_NOISE: the averaging window of ORATE 7 (4ms); if the host reads faster than
+		  4ms the sensor averages for one period and the host averages the readings of the window
+	- RateInfo() reports the mean age of the value returned (the sensor output is half a refresh
+	  old when updated and is read on average half a refresh later, the host average adds half of
+	  its window) and the expected noise (readings of the same refresh are not independent)
+	- RATE_NOISE is a nominal value, the absolute noise depends on the magnet and the air gap: the
+	  ratios between the profiles hold anyway
+	- RateApply() (SetOutputRate()) changes ORATE of a running sensor without a new setup
+	- AcquisitionSetRate() applies a profile to a sensor of the acquisition thread: ORATE and the
+	  host average of its readings (see acquisition.c), AveragerAdd() is the same average for the
+	  other reading loops
+	- The host average is returned in Degrees, not rounded to a count: a count (0.088 Degrees)
+	  alone is 0.025 Degrees rms of quantization, as much as the averaged noise of RateInfo()
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "angle.h"
+#include "rate.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static double refreshTime(uint8_t orate)
+{
+	return (double)ORATE_SAMPLE * (double)(1 << orate);
+}
+
+/*Largest ORATE with a refresh time not longer than us*/
+static uint8_t fitOutputRate(double us)
+{
+	uint8_t orate = 0;
+
+	while((orate < ORATE_MAX) && (refreshTime(orate + 1) <= us))
+		orate++;
+
+	return orate;
+}
+
+void RateInfo(uint8_t orate, int average, uint64_t period, A1335rate *rate)
+{
+	double p = (double)period / 1000.0, independent;
+
+	if(average < 1)
+		average = 1;
+
+	rate->orate = orate;
+	rate->average = average;
+	rate->period = period;
+	rate->refresh = refreshTime(orate);
+
+	/*Age: sensor window and refresh, plus the host window*/
+	rate->age = rate->refresh + (average - 1) * p / 2.0;
+
+	/*Readings closer than the refresh time repeat the same angle*/
+	independent = (p >= rate->refresh) ? average : fmax(1.0, average * p / rate->refresh);
+	rate->noise = RATE_NOISE / sqrt((double)(1 << orate)) / sqrt(independent);
+}
+
+int RateProfile(int profile, uint64_t period, A1335rate *rate)
+{
+	double p = (double)period / 1000.0;
+	uint8_t orate;
+	int average = 1;
+
+	switch(profile)
+	{
+		case RATE_LOW_LATENCY:
+			orate = 0;
+			break;
+
+		case RATE_BALANCED:
+			orate = (period == 0) ? 4 : fitOutputRate(p);
+			break;
+
+		case RATE_LOW_NOISE:
+			if((period == 0) || (p >= refreshTime(ORATE_MAX)))
+				orate = ORATE_MAX;
+			else
+			{
+				/*The host completes the window of ORATE_MAX*/
+				orate = fitOutputRate(p);
+				average = (int)ceil(refreshTime(ORATE_MAX) / p);
+				if(average > RATE_MAX_AVERAGE)
+					average = RATE_MAX_AVERAGE;
+			}
+			break;
+
+		default:
+			return ERROR;
+	}
+
+	RateInfo(orate, average, period, rate);
+	rate->profile = profile;
+
+	return NOERROR;
+}
+
+int RateApply(int cs, uint8_t buffer[], const A1335rate *rate)
+{
+	return SetOutputRate(cs, buffer, rate->orate);
+}
+
+const char *RateProfileName(int profile)
+{
+	switch(profile)
+	{
+		case RATE_LOW_LATENCY:	return "Low latency";
+		case RATE_BALANCED:		return "Balanced";
+		case RATE_LOW_NOISE:	return "Low noise";
+	}
+
+	return "Unknown";
+}
+
+void AveragerInit(A1335averager *averager, int n)
+{
+	if(n < 1)
+		n = 1;
+	if(n > RATE_MAX_AVERAGE)
+		n = RATE_MAX_AVERAGE;
+
+	averager->n = n;
+	averager->count = 0;
+	averager->next = 0;
+	averager->last = 0;
+	averager->unwrapped = 0;
+	averager->sum = 0;
+}
+
+int AveragerAdd(A1335averager *averager, uint16_t count, double *average)
+{
+	int delta;
+	double mean;
+
+	/*Unwrap on the shortest way from the previous count*/
+	if(averager->count == 0)
+		averager->unwrapped = count;
+	else
+	{
+		delta = (int)count - (int)averager->last;
+		if(delta >= ANGLE_COUNTS / 2)
+			delta -= ANGLE_COUNTS;
+		else if(delta < -ANGLE_COUNTS / 2)
+			delta += ANGLE_COUNTS;
+		averager->unwrapped += delta;
+	}
+	averager->last = count;
+
+	/*Replace the oldest reading of the window*/
+	if(averager->count == averager->n)
+		averager->sum -= averager->window[averager->next];
+	else
+		averager->count++;
+
+	averager->window[averager->next] = averager->unwrapped;
+	averager->sum += averager->unwrapped;
+	averager->next = (averager->next + 1) % averager->n;
+
+	/*Mean not rounded to a count (the resolution is the point of the average), back in 0:360*/
+	mean = fmod((double)averager->sum / (double)averager->count, (double)ANGLE_COUNTS);
+	if(mean < 0.0)
+		mean += (double)ANGLE_COUNTS;
+	*average = mean * 360.0 / (double)ANGLE_COUNTS;
+	if(*average >= 360.0)
+		*average -= 360.0;
+
+	/*Window not full yet*/
+	if(averager->count < averager->n)
+		return ERROR;
+
+	return NOERROR;
+}
@@ -0,0 +1,65 @@
+#ifndef RATE_H__
+#define RATE_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+/*Profiles*/
+#define RATE_LOW_LATENCY 0		//ORATE 0: new angle every 32us, highest noise
+#define RATE_BALANCED 1			//Largest ORATE with a new angle at every reading of the host
+#define RATE_LOW_NOISE 2		//Averaging window of ORATE 7 (4ms), completed by the host if it reads faster
+#define RATE_PROFILES 3
+
+#define RATE_NOISE 0.2			//Angle noise with ORATE 0 (in Degrees rms, nominal: measure it for the magnet in use)
+#define RATE_MAX_AVERAGE 64		//Max number of readings averaged by the host
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Output rate of a sensor and its effect on the readings*/
+typedef struct
+{
+	int profile;			//RATE_LOW_LATENCY, RATE_BALANCED, RATE_LOW_NOISE
+	uint8_t orate;			//Samples averaged by the sensor (2^orate)
+	int average;			//Readings averaged by the host (1 = none)
+	uint64_t period;		//Time between two readings of the host (in ns)
+	double refresh;			//Time between two new angles of the sensor (in us)
+	double age;				//Mean age of the value returned (in us), from the middle of the averaging window
+	double noise;			//Expected noise of the value returned (in Degrees rms)
+} A1335rate;
+
+/*Host moving average of the angle counts (unwrapped, so the average is correct across 0/360 Degrees)*/
+typedef struct
+{
+	int n;									//Readings averaged
+	int count;								//Readings in the window
+	int next;								//Oldest reading of the window
+	uint16_t last;							//Last count (0:4095)
+	int64_t unwrapped;						//Last count unwrapped
+	int64_t sum;							//Sum of the window
+	int64_t window[RATE_MAX_AVERAGE];
+} A1335averager;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int RateProfile(int profile, uint64_t period, A1335rate *rate);
+void RateInfo(uint8_t orate, int average, uint64_t period, A1335rate *rate);
+int RateApply(int cs, uint8_t buffer[], const A1335rate *rate);
+const char *RateProfileName(int profile);
+void AveragerInit(A1335averager *averager, int n);
+int AveragerAdd(A1335averager *averager, uint16_t count, double *average);
+
+#endif
@@ -0,0 +1,188 @@
+/*******************************************
+
+	University of Udine
+
+	Lock-free single producer / single
+	consumer ring of samples
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- head is written only by the producer and tail by the consumer, each on its own cache line;
+	  each side keeps a cached copy of the other index and reloads it only when needed
+	- RingPopBatch() copies up to max samples with at most two memcpy() and a single update of tail
+	- RING_DROP_NEWEST: a push to a full ring is discarded
+	- RING_DROP_OLDEST: a push never waits and overwrites the oldest sample; the consumer skips the
+	  samples it has been lapped by and discards the copies the producer may have overwritten while
+	  they were copied (checking head again after the copy)
+	- Both policies count the dropped samples
+	- RingPublish() can be used as publish callback of the acquisition thread
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "angle.h"
+#include "ring.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+int RingInit(A1335ring *ring, size_t capacity, int policy)
+{
+	/*The capacity must be a power of 2*/
+	if((capacity < 2) || ((capacity & (capacity - 1)) != 0))
+		return ERROR;
+
+	ring->slots = aligned_alloc(RING_CACHE_LINE, ((capacity * sizeof(A1335sample) + RING_CACHE_LINE - 1) / RING_CACHE_LINE) * RING_CACHE_LINE);
+	if(ring->slots == NULL)
+		return ERROR;
+
+	ring->capacity = capacity;
+	ring->mask = capacity - 1;
+	ring->policy = policy;
+	ring->cachedTail = 0;
+	ring->cachedHead = 0;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->dropped, 0);
+
+	return NOERROR;
+}
+
+void RingFree(A1335ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+int RingPush(A1335ring *ring, const A1335sample *sample)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	if(ring->policy == RING_DROP_NEWEST)
+	{
+		/*Full according to the cached tail: reload it*/
+		if(head - ring->cachedTail >= ring->capacity)
+		{
+			ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+			if(head - ring->cachedTail >= ring->capacity)
+			{
+				atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+				return ERROR;
+			}
+		}
+	}
+	else
+	{
+		/*The slot may be overwritten under a reader: head must be visible before the new content*/
+		atomic_thread_fence(memory_order_release);
+	}
+
+	ring->slots[head & ring->mask] = *sample;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return NOERROR;
+}
+
+size_t RingPopBatch(A1335ring *ring, A1335sample samples[], size_t max)
+{
+	size_t tail, head, n, first, lost;
+
+	tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	while(1)
+	{
+		/*Empty according to the cached head: reload it*/
+		if(ring->cachedHead - tail < max)
+			ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+		/*Lapped by the producer (RING_DROP_OLDEST): skip the overwritten samples*/
+		n = ring->cachedHead - tail;
+		if(n > ring->capacity)
+		{
+			atomic_fetch_add_explicit(&ring->dropped, n - ring->capacity, memory_order_relaxed);
+			tail = ring->cachedHead - ring->capacity;
+			n = ring->capacity;
+		}
+
+		if(n > max)
+			n = max;
+		if(n == 0)
+			break;
+
+		/*Copy in at most two segments*/
+		first = ring->capacity - (tail & ring->mask);
+		if(first > n)
+			first = n;
+		memcpy(samples, &ring->slots[tail & ring->mask], first * sizeof(A1335sample));
+		memcpy(samples + first, &ring->slots[0], (n - first) * sizeof(A1335sample));
+
+		if(ring->policy == RING_DROP_NEWEST)
+		{
+			tail += n;
+			break;
+		}
+
+		/*Discard the copies the producer may have overwritten meanwhile (slot of index i reused by index i + capacity)*/
+		atomic_thread_fence(memory_order_acquire);
+		head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+		lost = (head + 1 > tail + ring->capacity) ? head + 1 - ring->capacity - tail : 0;
+
+		if(lost >= n)
+		{
+			atomic_fetch_add_explicit(&ring->dropped, n, memory_order_relaxed);
+			tail += n;
+			ring->cachedHead = head;
+			continue;
+		}
+
+		if(lost > 0)
+		{
+			atomic_fetch_add_explicit(&ring->dropped, lost, memory_order_relaxed);
+			memmove(samples, samples + lost, (n - lost) * sizeof(A1335sample));
+		}
+
+		tail += n;
+		n -= lost;
+		break;
+	}
+
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+	return n;
+}
+
+size_t RingCount(A1335ring *ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+uint64_t RingDropped(A1335ring *ring)
+{
+	return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+void RingPublish(const A1335sample *sample, void *ctx)
+{
+	RingPush((A1335ring *)ctx, sample);
+}
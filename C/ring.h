@@ -0,0 +1,61 @@
+#ifndef RING_H__
+#define RING_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "sample.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define RING_CACHE_LINE 64		//Cache line size (in bytes)
+
+/*Overflow policies*/
+#define RING_DROP_NEWEST 0		//A full ring drops the sample pushed
+#define RING_DROP_OLDEST 1		//A full ring drops the oldest sample to make room
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Single producer / single consumer ring of samples (declare it static or on the stack to keep the alignment)*/
+typedef struct
+{
+	/*Producer side*/
+	_Alignas(RING_CACHE_LINE) atomic_size_t head;	//Next slot written
+	size_t cachedTail;								//Last tail seen by the producer
+	atomic_uint_fast64_t dropped;					//Samples dropped by the overflow policy
+
+	/*Consumer side*/
+	_Alignas(RING_CACHE_LINE) atomic_size_t tail;	//Next slot read
+	size_t cachedHead;								//Last head seen by the consumer
+
+	/*Read only after RingInit()*/
+	_Alignas(RING_CACHE_LINE) A1335sample *slots;
+	size_t capacity;								//Number of slots (power of 2)
+	size_t mask;
+	int policy;										//RING_DROP_NEWEST or RING_DROP_OLDEST
+} A1335ring;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int RingInit(A1335ring *ring, size_t capacity, int policy);
+void RingFree(A1335ring *ring);
+int RingPush(A1335ring *ring, const A1335sample *sample);
+size_t RingPopBatch(A1335ring *ring, A1335sample samples[], size_t max);
+size_t RingCount(A1335ring *ring);
+uint64_t RingDropped(A1335ring *ring);
+void RingPublish(const A1335sample *sample, void *ctx);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SAMPLE_H__
+#define SAMPLE_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include "angle.h"
+#include "estimator.h"
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Timestamped reading of a sensor*/
+typedef struct
+{
+	uint64_t timestamp;			//CLOCK_MONOTONIC time of the reading (in ns)
+	uint64_t sequence;			//Number of the reading of the sensor
+	int cs;						//Chip select of the sensor
+	int error;					//NOERROR, ERROR if the reading failed, PARITYERROR if the angle parity check failed
+	A1335snapshot snapshot;		//Angle, status, temperature and field
+	A1335estimate estimate;		//Multi-turn position, velocity and acceleration after this reading
+} A1335sample;
+
+#endif
@@ -0,0 +1,297 @@
+/*******************************************
+
+	University of Udine
+
+	Shared memory bus of samples for the
+	Allegro A1335 (one writer, many readers)
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The writer (e.g. the acquisition thread through SampleBusPublish()) publishes the samples
+	  into a POSIX shared memory object, any number of local processes map it read only with
+	  SampleBusOpen()
+	- Every slot has its own sequence number: the writer never waits for the readers and the
+	  readers never write, so a slow or stopped reader cannot slow the writer
+	- The read path has no system calls: SampleBusPeek() returns the sample in place (zero copy),
+	  SampleBusCheck() tells afterwards whether the writer has overwritten it meanwhile
+	- A reader lapped by the writer gets SAMPLEBUS_LAPPED, SampleBusPoll() skips the overwritten
+	  samples and counts them in lost
+	- Link with -lrt on older C libraries (shm_open())
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include "angle.h"
+#include "samplebus.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static size_t busSize(uint64_t capacity)
+{
+	return sizeof(A1335samplebusHeader) + capacity * sizeof(A1335samplebusSlot);
+}
+
+static void busMap(A1335samplebus *bus, void *map, size_t size, int writer)
+{
+	bus->header = (A1335samplebusHeader *)map;
+	bus->slots = (A1335samplebusSlot *)((uint8_t *)map + sizeof(A1335samplebusHeader));
+	bus->size = size;
+	bus->mask = bus->header->capacity - 1;
+	bus->writer = writer;
+}
+
+int SampleBusCreate(A1335samplebus *bus, const char *name, size_t capacity)
+{
+	A1335samplebusHeader *header;
+	size_t size, i;
+	void *map;
+	int fd;
+
+	/*The capacity must be a power of 2*/
+	if((capacity < 2) || ((capacity & (capacity - 1)) != 0))
+		return ERROR;
+
+	size = busSize(capacity);
+
+	fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if(fd < 0)
+		return ERROR;
+
+	if(ftruncate(fd, size) < 0)
+	{
+		close(fd);
+		return ERROR;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return ERROR;
+
+	/*The magic number is written last: readers opening the bus meanwhile fail*/
+	header = (A1335samplebusHeader *)map;
+	header->magic = 0;
+	header->version = SAMPLEBUS_VERSION;
+	header->sampleSize = sizeof(A1335sample);
+	header->slotSize = sizeof(A1335samplebusSlot);
+	header->capacity = capacity;
+	atomic_store_explicit(&header->head, 0, memory_order_relaxed);
+
+	busMap(bus, map, size, 1);
+
+	for(i = 0; i < capacity; i++)
+		atomic_store_explicit(&bus->slots[i].seq, 0, memory_order_relaxed);
+
+	atomic_thread_fence(memory_order_release);
+	header->magic = SAMPLEBUS_MAGIC;
+
+	return NOERROR;
+}
+
+int SampleBusOpen(A1335samplebus *bus, const char *name)
+{
+	A1335samplebusHeader header;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0)
+		return ERROR;
+
+	if((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(A1335samplebusHeader)) || (pread(fd, &header, sizeof(header), 0) != sizeof(header)))
+	{
+		close(fd);
+		return ERROR;
+	}
+
+	/*Same layout of the writer*/
+	if((header.magic != SAMPLEBUS_MAGIC) || (header.version != SAMPLEBUS_VERSION) ||
+	   (header.sampleSize != sizeof(A1335sample)) || (header.slotSize != sizeof(A1335samplebusSlot)) ||
+	   (header.capacity < 2) || ((header.capacity & (header.capacity - 1)) != 0) ||
+	   ((size_t)st.st_size < busSize(header.capacity)))
+	{
+		close(fd);
+		return ERROR;
+	}
+
+	map = mmap(NULL, busSize(header.capacity), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return ERROR;
+
+	busMap(bus, map, busSize(header.capacity), 0);
+
+	return NOERROR;
+}
+
+void SampleBusClose(A1335samplebus *bus)
+{
+	if(bus->header != NULL)
+		munmap(bus->header, bus->size);
+
+	bus->header = NULL;
+	bus->slots = NULL;
+}
+
+void SampleBusUnlink(const char *name)
+{
+	shm_unlink(name);
+}
+
+void SampleBusWrite(A1335samplebus *bus, const A1335sample *sample)
+{
+	uint64_t index = atomic_load_explicit(&bus->header->head, memory_order_relaxed);
+	A1335samplebusSlot *slot = &bus->slots[index & bus->mask];
+
+	/*Odd sequence while the sample is written*/
+	atomic_store_explicit(&slot->seq, 2 * index + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->sample = *sample;
+	atomic_store_explicit(&slot->seq, 2 * index + 2, memory_order_release);
+
+	atomic_store_explicit(&bus->header->head, index + 1, memory_order_release);
+}
+
+void SampleBusPublish(const A1335sample *sample, void *ctx)
+{
+	SampleBusWrite((A1335samplebus *)ctx, sample);
+}
+
+uint64_t SampleBusHead(A1335samplebus *bus)
+{
+	return atomic_load_explicit(&bus->header->head, memory_order_acquire);
+}
+
+const A1335sample *SampleBusPeek(A1335samplebus *bus, uint64_t index)
+{
+	A1335samplebusSlot *slot = &bus->slots[index & bus->mask];
+
+	if(atomic_load_explicit(&slot->seq, memory_order_acquire) != 2 * index + 2)
+		return NULL;
+
+	return &slot->sample;
+}
+
+int SampleBusCheck(A1335samplebus *bus, uint64_t index)
+{
+	A1335samplebusSlot *slot = &bus->slots[index & bus->mask];
+
+	/*The sample read in place is valid only if the slot still holds the same index*/
+	atomic_thread_fence(memory_order_acquire);
+	if(atomic_load_explicit(&slot->seq, memory_order_relaxed) != 2 * index + 2)
+		return SAMPLEBUS_LAPPED;
+
+	return NOERROR;
+}
+
+int SampleBusRead(A1335samplebus *bus, uint64_t index, A1335sample *sample)
+{
+	A1335samplebusSlot *slot = &bus->slots[index & bus->mask];
+	uint64_t seq;
+
+	seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+	/*Not written yet or being written*/
+	if(seq < 2 * index + 2)
+		return ERROR;
+
+	/*Slot reused by a later index*/
+	if(seq > 2 * index + 2)
+		return SAMPLEBUS_LAPPED;
+
+	*sample = slot->sample;
+
+	return SampleBusCheck(bus, index);
+}
+
+int SampleBusLatest(A1335samplebus *bus, A1335sample *sample)
+{
+	uint64_t head;
+
+	do
+	{
+		head = SampleBusHead(bus);
+
+		/*No sample yet*/
+		if(head == 0)
+			return ERROR;
+
+	} while(SampleBusRead(bus, head - 1, sample) != NOERROR);
+
+	return NOERROR;
+}
+
+void SampleBusReaderInit(A1335samplebusReader *reader, A1335samplebus *bus, uint64_t history)
+{
+	uint64_t head = SampleBusHead(bus);
+
+	/*Start history samples back (at most the whole ring)*/
+	if(history > bus->header->capacity)
+		history = bus->header->capacity;
+	if(history > head)
+		history = head;
+
+	reader->bus = bus;
+	reader->next = head - history;
+	reader->lost = 0;
+}
+
+size_t SampleBusPoll(A1335samplebusReader *reader, A1335sample samples[], size_t max)
+{
+	A1335samplebus *bus = reader->bus;
+	uint64_t head = SampleBusHead(bus);
+	size_t n = 0;
+	int result;
+
+	while((n < max) && (reader->next < head))
+	{
+		/*Lapped: the oldest samples still in the ring start at head - capacity*/
+		if(head - reader->next > bus->header->capacity)
+		{
+			reader->lost += head - bus->header->capacity - reader->next;
+			reader->next = head - bus->header->capacity;
+		}
+
+		result = SampleBusRead(bus, reader->next, &samples[n]);
+
+		if(result == NOERROR)
+			n++;
+		else if(result == SAMPLEBUS_LAPPED)
+		{
+			reader->lost++;
+			head = SampleBusHead(bus);
+		}
+		else
+			break;
+
+		reader->next++;
+	}
+
+	return n;
+}
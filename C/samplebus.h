@@ -0,0 +1,84 @@
+#ifndef SAMPLEBUS_H__
+#define SAMPLEBUS_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "sample.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define SAMPLEBUS_NAME "/a1335_samples"	//Default shared memory object
+#define SAMPLEBUS_MAGIC 0x41313335		//"A135"
+#define SAMPLEBUS_VERSION 1
+#define SAMPLEBUS_CACHE_LINE 64			//Cache line size (in bytes)
+#define SAMPLEBUS_LAPPED -2				//The sample has been overwritten by the writer
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Slot of the shared ring: seq is 2 * index + 1 while the sample of that index is written, 2 * index + 2 once written*/
+typedef struct
+{
+	_Alignas(SAMPLEBUS_CACHE_LINE) atomic_uint_fast64_t seq;
+	A1335sample sample;
+} A1335samplebusSlot;
+
+/*Header of the shared memory object, followed by the slots*/
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sampleSize;									//sizeof(A1335sample) of the writer
+	uint32_t slotSize;										//sizeof(A1335samplebusSlot) of the writer
+	uint64_t capacity;										//Number of slots (power of 2)
+	_Alignas(SAMPLEBUS_CACHE_LINE) atomic_uint_fast64_t head;	//Number of samples published
+} A1335samplebusHeader;
+
+/*Mapping of the shared memory object*/
+typedef struct
+{
+	A1335samplebusHeader *header;
+	A1335samplebusSlot *slots;
+	size_t size;			//Size of the mapping (in bytes)
+	uint64_t mask;
+	int writer;				//1 if created by SampleBusCreate()
+} A1335samplebus;
+
+/*Position of a reader in the bus*/
+typedef struct
+{
+	A1335samplebus *bus;
+	uint64_t next;			//Index of the next sample read
+	uint64_t lost;			//Samples overwritten before the reader got them
+} A1335samplebusReader;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int SampleBusCreate(A1335samplebus *bus, const char *name, size_t capacity);
+int SampleBusOpen(A1335samplebus *bus, const char *name);
+void SampleBusClose(A1335samplebus *bus);
+void SampleBusUnlink(const char *name);
+void SampleBusWrite(A1335samplebus *bus, const A1335sample *sample);
+void SampleBusPublish(const A1335sample *sample, void *ctx);
+uint64_t SampleBusHead(A1335samplebus *bus);
+const A1335sample *SampleBusPeek(A1335samplebus *bus, uint64_t index);
+int SampleBusCheck(A1335samplebus *bus, uint64_t index);
+int SampleBusRead(A1335samplebus *bus, uint64_t index, A1335sample *sample);
+int SampleBusLatest(A1335samplebus *bus, A1335sample *sample);
+void SampleBusReaderInit(A1335samplebusReader *reader, A1335samplebus *bus, uint64_t history);
+size_t SampleBusPoll(A1335samplebusReader *reader, A1335sample samples[], size_t max);
+
+#endif
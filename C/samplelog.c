@@ -0,0 +1,182 @@
+/*******************************************
+
+	University of Udine
+
+	Binary log of the Allegro A1335 samples
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The log is a 64 bytes header followed by fixed size records (A1335logRecord) with the chip
+	  select, the timestamp, the raw register words and the decoded values
+	- The file is preallocated (posix_fallocate()) and written through a shared mapping: a record
+	  costs a memory copy, the kernel writes the pages back in the background
+	- When the preallocated records are used up the file grows by the same amount: the only step
+	  with system calls, size the log to avoid it while acquiring. If it cannot grow (e.g. full card)
+	  the record is dropped (ERROR), the records written stay mapped and the log can be closed
+	- count in the header is updated at every record, so a log not closed (e.g. power loss) is
+	  still readable up to the last record written back
+	- SampleLogClose() truncates the file to the records written
+	- log2csv.c converts a log to CSV
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "angle.h"
+#include "samplelog.h"
+
+/*The file format does not depend on the compiler*/
+_Static_assert(sizeof(A1335logHeader) == 64, "A1335logHeader must be 64 bytes");
+_Static_assert(sizeof(A1335logRecord) == 40, "A1335logRecord must be 40 bytes");
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static A1335logHeader *logHeader(A1335log *log)
+{
+	return (A1335logHeader *)log->map;
+}
+
+/*Map capacity records, the previous mapping (if any) is kept on failure: the log stays writable up to its capacity*/
+static int logMap(A1335log *log, uint64_t capacity)
+{
+	size_t size = sizeof(A1335logHeader) + capacity * sizeof(A1335logRecord);
+	uint8_t *map;
+
+	/*Allocate the blocks now: no allocation (nor SIGBUS on a full card) while writing*/
+	if(posix_fallocate(log->fd, 0, size) != 0)
+		return ERROR;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, 0);
+	if(map == MAP_FAILED)
+		return ERROR;
+
+	/*Same file: the new mapping holds the records written so far*/
+	if(log->map != NULL)
+		munmap(log->map, log->size);
+
+	log->map = map;
+	log->size = size;
+	log->capacity = capacity;
+
+	return NOERROR;
+}
+
+void SampleLogRecord(const A1335sample *sample, A1335logRecord *record)
+{
+	record->timestamp = sample->timestamp;
+	record->sequence = (uint32_t)sample->sequence;
+	record->device = (uint16_t)sample->cs;
+	record->error = (int16_t)sample->error;
+	record->angleWord = sample->snapshot.angleWord;
+	record->status = sample->snapshot.status;
+	record->tempWord = sample->snapshot.tempWord;
+	record->fieldWord = sample->snapshot.fieldWord;
+	record->angle = sample->snapshot.angle;
+	record->temp = sample->snapshot.temp;
+	record->field = sample->snapshot.field;
+	record->reserved = 0;
+}
+
+int SampleLogOpen(A1335log *log, const char *path, uint64_t records)
+{
+	A1335logHeader *header;
+
+	if(records == 0)
+		records = SAMPLELOG_RECORDS;
+
+	log->fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if(log->fd < 0)
+		return ERROR;
+
+	log->chunk = records;
+	log->map = NULL;
+	if(logMap(log, records) == ERROR)
+	{
+		close(log->fd);
+		return ERROR;
+	}
+
+	header = logHeader(log);
+	memset(header, 0, sizeof(A1335logHeader));
+	memcpy(header->magic, SAMPLELOG_MAGIC, sizeof(header->magic));
+	header->version = SAMPLELOG_VERSION;
+	header->recordSize = sizeof(A1335logRecord);
+	header->count = 0;
+
+	return NOERROR;
+}
+
+int SampleLogWrite(A1335log *log, const A1335sample *sample)
+{
+	A1335logRecord *records;
+	uint64_t count = logHeader(log)->count;
+
+	/*File full: grow it by a chunk (full card: the record is dropped, the log stays as it is)*/
+	if((count == log->capacity) && (logMap(log, log->capacity + log->chunk) == ERROR))
+		return ERROR;
+
+	records = (A1335logRecord *)(log->map + sizeof(A1335logHeader));
+	SampleLogRecord(sample, &records[count]);
+	logHeader(log)->count = count + 1;
+
+	return NOERROR;
+}
+
+void SampleLogPublish(const A1335sample *sample, void *ctx)
+{
+	SampleLogWrite((A1335log *)ctx, sample);
+}
+
+int SampleLogSync(A1335log *log)
+{
+	/*Schedule the write back without waiting for it*/
+	if(msync(log->map, log->size, MS_ASYNC) < 0)
+		return ERROR;
+
+	return NOERROR;
+}
+
+int SampleLogClose(A1335log *log)
+{
+	int result = NOERROR;
+	size_t size;
+
+	if(log->map == NULL)
+		return ERROR;
+
+	size = sizeof(A1335logHeader) + logHeader(log)->count * sizeof(A1335logRecord);
+
+	if(msync(log->map, log->size, MS_SYNC) < 0)
+		result = ERROR;
+	munmap(log->map, log->size);
+	log->map = NULL;
+
+	/*Drop the records preallocated and not used*/
+	if(ftruncate(log->fd, size) < 0)
+		result = ERROR;
+	close(log->fd);
+
+	return result;
+}
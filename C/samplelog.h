@@ -0,0 +1,75 @@
+#ifndef SAMPLELOG_H__
+#define SAMPLELOG_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stddef.h>
+#include "sample.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define SAMPLELOG_MAGIC "A1335LOG"		//First 8 bytes of the file
+#define SAMPLELOG_VERSION 1
+#define SAMPLELOG_RECORDS 65536			//Default number of records preallocated at a time
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*File header (64 bytes), the records follow*/
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;		//sizeof(A1335logRecord)
+	uint64_t count;				//Number of records written (updated at every record)
+	uint8_t reserved[40];
+} A1335logHeader;
+
+/*Fixed size record (40 bytes, little endian as written by the host)*/
+typedef struct
+{
+	uint64_t timestamp;			//CLOCK_MONOTONIC time of the reading (in ns)
+	uint32_t sequence;			//Number of the reading of the sensor
+	uint16_t device;			//Chip select of the sensor
+	int16_t error;				//NOERROR, ERROR if the reading failed
+	uint16_t angleWord;			//Raw ANG register 0x20
+	uint16_t status;			//Raw STA register 0x22
+	uint16_t tempWord;			//Raw TSEN register 0x28
+	uint16_t fieldWord;			//Raw FIELD register 0x2A
+	float angle;				//Decoded angle (in Degrees)
+	float temp;					//Decoded temperature (in Celsius)
+	float field;				//Decoded field (in Gauss)
+	uint32_t reserved;
+} A1335logRecord;
+
+/*Memory mapped log file*/
+typedef struct
+{
+	int fd;
+	uint8_t *map;				//Mapping of the whole file
+	size_t size;				//Size of the file (in bytes)
+	uint64_t capacity;			//Records that fit in the file
+	uint64_t chunk;				//Records added when the file is full
+} A1335log;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int SampleLogOpen(A1335log *log, const char *path, uint64_t records);
+int SampleLogWrite(A1335log *log, const A1335sample *sample);
+void SampleLogPublish(const A1335sample *sample, void *ctx);
+int SampleLogSync(A1335log *log);
+int SampleLogClose(A1335log *log);
+void SampleLogRecord(const A1335sample *sample, A1335logRecord *record);
+
+#endif
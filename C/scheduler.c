@@ -0,0 +1,323 @@
+/*******************************************
+
+	University of Udine
+
+	Bus scheduler for many Allegro A1335 on
+	the same SPI bus
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Each sensor has a target rate and a priority, the chip selects are hardware CE lines or
+	  GPIO pins (SPIsetDevice())
+	- SchedulerBuild() rounds the periods down to a harmonic grid (the shortest period times a
+	  power of 2, so every rate is met or exceeded), the cycle is the longest period
+	- The readings of a cycle are laid out by non-preemptive EDF (earliest deadline first, ties
+	  to the higher priority) using the bus time of a reading (transfer cost plus frames): the
+	  readings are back to back while any is due, and the build fails if a deadline (the end of
+	  the period) cannot be met
+	- With SCHEDULER_DEGRADE the rates of the lowest priorities are halved until the schedule fits
+	- SchedulerRun() replays the cycle on absolute times and counts, for each sensor, the readings,
+	  the deadlines missed (e.g. a transfer slower than its cost) and the max lateness;
+	  SchedulerRate() is the rate achieved
+	- The costs are estimates: set transferCost and frameCost to the times measured on the target.
+	  The frames of a sensor last its bits (20 with the CRC framing) at its own clock (SPIsetSpeed(),
+	  see calibrate.c) plus the rest of frameCost: faster sensors leave more of the bus to the others
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "angle.h"
+#include "scheduler.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+void SchedulerInit(A1335scheduler *scheduler)
+{
+	memset(scheduler, 0, sizeof(A1335scheduler));
+
+	/*16 bits at the SPI clock plus the chip select time*/
+	scheduler->transferCost = SCHEDULER_TRANSFER_COST;
+	scheduler->frameCost = 16ULL * 1000000000ULL / SPI_CLOCK + SCHEDULER_FRAME_GAP;
+}
+
+int SchedulerAdd(A1335scheduler *scheduler, int cs, double rate, int priority)
+{
+	A1335scheduled *sensor;
+
+	if((scheduler->n >= SCHEDULER_MAX_SENSORS) || (rate <= 0.0))
+		return ERROR;
+
+	sensor = &scheduler->sensors[scheduler->n];
+	memset(sensor, 0, sizeof(A1335scheduled));
+	sensor->cs = cs;
+	sensor->rate = rate;
+	sensor->priority = priority;
+
+	return scheduler->n++;
+}
+
+/*Bus time of a frame of the sensor on cs*/
+static uint64_t sensorFrameCost(const A1335scheduler *scheduler, int cs)
+{
+	uint64_t bits = 16ULL * 1000000000ULL / SPI_CLOCK;
+	uint64_t own = (SPIgetCRC(cs) ? 20ULL : 16ULL) * 1000000000ULL / SPIgetSpeed(cs);
+
+	/*frameCost holds 16 bits at SPI_CLOCK: replaced by the bits at the clock of the sensor*/
+	if(scheduler->frameCost < bits)
+		return own;
+
+	return scheduler->frameCost - bits + own;
+}
+
+/*Periods on the harmonic grid, cycle and utilization*/
+static int layoutPeriods(A1335scheduler *scheduler)
+{
+	uint64_t base = 0, target;
+	int i, slots = 0;
+
+	for(i = 0; i < scheduler->n; i++)
+	{
+		target = (uint64_t)(1e9 / scheduler->sensors[i].rate);
+		if((base == 0) || (target < base))
+			base = target;
+	}
+
+	scheduler->hyperperiod = 0;
+	scheduler->utilization = 0.0;
+
+	for(i = 0; i < scheduler->n; i++)
+	{
+		A1335scheduled *sensor = &scheduler->sensors[i];
+
+		target = (uint64_t)(1e9 / sensor->rate);
+		sensor->period = base;
+		while(sensor->period * 2 <= target)
+			sensor->period *= 2;
+		sensor->period <<= sensor->degraded;
+
+		sensor->cost = scheduler->transferCost + SCHEDULER_FRAMES * sensorFrameCost(scheduler, sensor->cs);
+		scheduler->utilization += (double)sensor->cost / (double)sensor->period;
+
+		if(sensor->period > scheduler->hyperperiod)
+			scheduler->hyperperiod = sensor->period;
+	}
+
+	for(i = 0; i < scheduler->n; i++)
+		slots += (int)(scheduler->hyperperiod / scheduler->sensors[i].period);
+
+	return slots;
+}
+
+/*Non-preemptive EDF over one cycle, NOERROR if every deadline is met*/
+static int layoutSlots(A1335scheduler *scheduler)
+{
+	uint64_t job[SCHEDULER_MAX_SENSORS], jobs[SCHEDULER_MAX_SENSORS];
+	uint64_t t = 0, release, deadline, best, earliest;
+	int i, pick, remaining = 0, result = NOERROR;
+
+	for(i = 0; i < scheduler->n; i++)
+	{
+		job[i] = 0;
+		jobs[i] = scheduler->hyperperiod / scheduler->sensors[i].period;
+		remaining += (int)jobs[i];
+	}
+
+	scheduler->nslots = 0;
+
+	while(remaining > 0)
+	{
+		pick = -1;
+		best = 0;
+		earliest = 0;
+
+		for(i = 0; i < scheduler->n; i++)
+		{
+			if(job[i] == jobs[i])
+				continue;
+
+			release = job[i] * scheduler->sensors[i].period;
+			deadline = release + scheduler->sensors[i].period;
+
+			if(release > t)
+			{
+				if((earliest == 0) || (release < earliest))
+					earliest = release;
+				continue;
+			}
+
+			if((pick < 0) || (deadline < best) || ((deadline == best) && (scheduler->sensors[i].priority > scheduler->sensors[pick].priority)))
+			{
+				pick = i;
+				best = deadline;
+			}
+		}
+
+		/*Nothing due: the bus is idle until the next release*/
+		if(pick < 0)
+		{
+			t = earliest;
+			continue;
+		}
+
+		scheduler->slots[scheduler->nslots].offset = t;
+		scheduler->slots[scheduler->nslots].deadline = best;
+		scheduler->slots[scheduler->nslots].sensor = pick;
+		scheduler->nslots++;
+
+		t += scheduler->sensors[pick].cost;
+		if(t > best)
+			result = ERROR;
+
+		job[pick]++;
+		remaining--;
+	}
+
+	return result;
+}
+
+int SchedulerBuild(A1335scheduler *scheduler, int options)
+{
+	int i, lowest;
+
+	if(scheduler->n <= 0)
+		return ERROR;
+
+	while(1)
+	{
+		if((layoutPeriods(scheduler) <= SCHEDULER_MAX_SLOTS) && (layoutSlots(scheduler) == NOERROR))
+			break;
+
+		if(!(options & SCHEDULER_DEGRADE))
+			return ERROR;
+
+		/*Halve the rate of the lowest priority (the fastest of them first)*/
+		lowest = -1;
+		for(i = 0; i < scheduler->n; i++)
+		{
+			if(scheduler->sensors[i].degraded >= 16)
+				continue;
+
+			if((lowest < 0) || (scheduler->sensors[i].priority < scheduler->sensors[lowest].priority) ||
+			   ((scheduler->sensors[i].priority == scheduler->sensors[lowest].priority) && (scheduler->sensors[i].period < scheduler->sensors[lowest].period)))
+				lowest = i;
+		}
+
+		if(lowest < 0)
+			return ERROR;
+
+		scheduler->sensors[lowest].degraded++;
+	}
+
+	return NOERROR;
+}
+
+static void sleepUntil(uint64_t t)
+{
+	struct timespec wake;
+
+	wake.tv_sec = t / 1000000000ULL;
+	wake.tv_nsec = t % 1000000000ULL;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+}
+
+void SchedulerRun(A1335scheduler *scheduler, AcquisitionPublish publish, void *ctx, atomic_int *running)
+{
+	uint8_t buffer[BUFFER_SIZE];
+	A1335scheduled *sensor;
+	A1335sample sample;
+	uint64_t cycle, begin, end;
+	int64_t lateness;
+	int i;
+
+	memset(&sample, 0, sizeof(sample));
+	scheduler->start = AcquisitionTime();
+	scheduler->stop = 0;
+	scheduler->cycles = 0;
+
+	for(i = 0; i < scheduler->n; i++)
+	{
+		sensor = &scheduler->sensors[i];
+		sensor->readings = 0;
+		sensor->misses = 0;
+		sensor->errors = 0;
+		sensor->maxLateness = -(int64_t)sensor->period;
+		sensor->maxCost = 0;
+	}
+
+	cycle = scheduler->start;
+
+	while(atomic_load_explicit(running, memory_order_relaxed))
+	{
+		for(i = 0; i < scheduler->nslots; i++)
+		{
+			sensor = &scheduler->sensors[scheduler->slots[i].sensor];
+
+			sleepUntil(cycle + scheduler->slots[i].offset);
+
+			begin = AcquisitionTime();
+			sample.cs = sensor->cs;
+			sample.sequence = sensor->readings;
+			sample.timestamp = begin;
+			memset(&sample.snapshot, 0, sizeof(A1335snapshot));	//A failed transfer writes nothing
+			sample.error = getSnapshot(sensor->cs, buffer, &sample.snapshot);
+			end = AcquisitionTime();
+
+			sensor->readings++;
+			if(sample.error != NOERROR)
+				sensor->errors++;
+			if((int64_t)(end - begin) > sensor->maxCost)
+				sensor->maxCost = (int64_t)(end - begin);
+
+			lateness = (int64_t)(end - (cycle + scheduler->slots[i].deadline));
+			if(lateness > 0)
+				sensor->misses++;
+			if(lateness > sensor->maxLateness)
+				sensor->maxLateness = lateness;
+
+			if(publish != NULL)
+				publish(&sample, ctx);
+		}
+
+		scheduler->cycles++;
+		cycle += scheduler->hyperperiod;
+
+		/*More than a cycle late: start again from now (the missed readings are not recovered)*/
+		if((int64_t)(AcquisitionTime() - (cycle + scheduler->hyperperiod)) > 0)
+			cycle = AcquisitionTime();
+	}
+
+	scheduler->stop = AcquisitionTime();
+}
+
+double SchedulerRate(A1335scheduler *scheduler, int i)
+{
+	uint64_t elapsed = ((scheduler->stop != 0) ? scheduler->stop : AcquisitionTime()) - scheduler->start;
+
+	if((i < 0) || (i >= scheduler->n) || (elapsed == 0))
+		return 0.0;
+
+	return (double)scheduler->sensors[i].readings * 1e9 / (double)elapsed;
+}
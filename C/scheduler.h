@@ -0,0 +1,92 @@
+#ifndef SCHEDULER_H__
+#define SCHEDULER_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample.h"
+#include "acquisition.h"
+#include "spi.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define SCHEDULER_MAX_SENSORS SPI_MAX_DEVICES	//Max number of sensors of a bus
+#define SCHEDULER_MAX_SLOTS 1024				//Max number of readings in a cycle of the schedule
+#define SCHEDULER_FRAMES 5						//Frames of a reading (getSnapshot())
+#define SCHEDULER_TRANSFER_COST 40000			//Default time of a transfer besides its frames (in ns, ioctl and scheduling)
+#define SCHEDULER_FRAME_GAP 2000				//Default chip select time between two frames (in ns)
+
+/*Options of SchedulerBuild()*/
+#define SCHEDULER_DEGRADE 0x01		//If the rates do not fit, halve the rates of the lowest priorities until they do
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Sensor of the bus*/
+typedef struct
+{
+	/*Configuration*/
+	int cs;
+	double rate;			//Target rate (in Hz)
+	int priority;			//Higher first (ties of deadlines, SCHEDULER_DEGRADE)
+
+	/*Schedule*/
+	uint64_t period;		//Period of the readings (in ns, rate rounded up to the harmonic grid)
+	uint64_t cost;			//Bus time of a reading (in ns)
+	int degraded;			//Times the rate has been halved by SCHEDULER_DEGRADE
+
+	/*Statistics*/
+	uint64_t readings;		//Readings done
+	uint64_t misses;		//Readings completed after their deadline
+	uint64_t errors;		//Readings failed (transfer error or angle parity error)
+	int64_t maxLateness;	//Max completion time from the deadline (in ns, negative = always early)
+	int64_t maxCost;		//Max bus time of a reading (in ns)
+} A1335scheduled;
+
+/*Reading of the cycle*/
+typedef struct
+{
+	uint64_t offset;		//Start from the beginning of the cycle (in ns)
+	uint64_t deadline;		//Deadline from the beginning of the cycle (in ns)
+	int sensor;				//Index of the sensor
+} A1335slot;
+
+typedef struct
+{
+	A1335scheduled sensors[SCHEDULER_MAX_SENSORS];
+	int n;
+	uint64_t transferCost;	//Time of a transfer besides its frames (in ns)
+	uint64_t frameCost;		//Time of a frame at SPI_CLOCK (in ns), the bit time follows the clock of each sensor
+
+	/*Cycle (built by SchedulerBuild())*/
+	A1335slot slots[SCHEDULER_MAX_SLOTS];
+	int nslots;
+	uint64_t hyperperiod;	//Duration of the cycle (in ns)
+	double utilization;		//Bus time used by the readings over the cycle
+
+	/*Run*/
+	uint64_t start;			//Start of the first cycle (CLOCK_MONOTONIC, in ns)
+	uint64_t stop;			//End of the run (0 while running)
+	uint64_t cycles;		//Cycles done
+} A1335scheduler;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void SchedulerInit(A1335scheduler *scheduler);
+int SchedulerAdd(A1335scheduler *scheduler, int cs, double rate, int priority);
+int SchedulerBuild(A1335scheduler *scheduler, int options);
+void SchedulerRun(A1335scheduler *scheduler, AcquisitionPublish publish, void *ctx, atomic_int *running);
+double SchedulerRate(A1335scheduler *scheduler, int i);
+
+#endif
@@ -0,0 +1,169 @@
+/*******************************************
+
+	University of Udine
+
+	Shadow copy of the Allegro A1335 extended
+	SRAM
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- A shadow attached to a chip select serves SRAMread() from memory (the first reading of a word
+	  goes to the device) and holds SRAMwrite() values until ShadowFlush()
+	- ShadowFlush() writes back only the dirty words, a word written many times is written once
+	- Without a shadow attached SRAMread() and SRAMwrite() are ExtendedRead() and ExtendedWrite()
+	- Addresses out of the shadow (e.g. ORATE 0xFFD0, unlock 0xFFFE) always go to the device
+	- SoftReset() and HardReset() invalidate the shadow: the SRAM is reloaded from the EEPROM and
+	  the words not yet flushed are lost
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "angle.h"
+#include "spi.h"
+#include "shadow.h"
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static A1335shadow *shadows[SPI_MAX_DEVICES];
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static A1335shadow *getShadow(int cs, uint16_t address)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES) || (address >= SHADOW_SIZE))
+		return NULL;
+
+	return shadows[cs];
+}
+
+void ShadowInit(A1335shadow *shadow)
+{
+	int i;
+
+	for(i = 0; i < SHADOW_SIZE; i++)
+		shadow->words[i] = 0x00000000;
+
+	shadow->valid = 0x00000000;
+	shadow->dirty = 0x00000000;
+}
+
+int ShadowAttach(int cs, A1335shadow *shadow)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	shadows[cs] = shadow;
+
+	return NOERROR;
+}
+
+void ShadowDetach(int cs)
+{
+	if((cs >= 0) && (cs < SPI_MAX_DEVICES))
+		shadows[cs] = NULL;
+}
+
+int ShadowLoad(int cs, uint8_t buffer[])
+{
+	uint32_t value;
+	uint16_t address;
+
+	/*Read every word not already known*/
+	for(address = 0; address < SHADOW_SIZE; address++)
+		if(SRAMread(cs, buffer, address, &value) == ERROR)
+			return ERROR;
+
+	return NOERROR;
+}
+
+int ShadowFlush(int cs, uint8_t buffer[])
+{
+	A1335shadow *shadow = getShadow(cs, 0x0000);
+	uint16_t address;
+
+	if(shadow == NULL)
+		return NOERROR;
+
+	for(address = 0; address < SHADOW_SIZE; address++)
+	{
+		if((shadow->dirty & ((uint32_t)1 << address)) == 0)
+			continue;
+
+		if(ExtendedWrite(cs, buffer, address, shadow->words[address]) == ERROR)
+			return ERROR;
+
+		shadow->dirty &= ~((uint32_t)1 << address);
+	}
+
+	return NOERROR;
+}
+
+void ShadowInvalidate(int cs)
+{
+	A1335shadow *shadow = getShadow(cs, 0x0000);
+
+	if(shadow != NULL)
+		ShadowInit(shadow);
+}
+
+int SRAMread(int cs, uint8_t buffer[], uint16_t address, uint32_t *value)
+{
+	A1335shadow *shadow = getShadow(cs, address);
+
+	if(shadow == NULL)
+		return ExtendedRead(cs, buffer, address, value);
+
+	/*Read from the device only the first time*/
+	if((shadow->valid & ((uint32_t)1 << address)) == 0)
+	{
+		if(ExtendedRead(cs, buffer, address, &shadow->words[address]) == ERROR)
+			return ERROR;
+
+		shadow->valid |= (uint32_t)1 << address;
+	}
+
+	*value = shadow->words[address];
+
+	return NOERROR;
+}
+
+int SRAMwrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value)
+{
+	A1335shadow *shadow = getShadow(cs, address);
+
+	if(shadow == NULL)
+		return ExtendedWrite(cs, buffer, address, value);
+
+	/*Nothing to do if the value is unchanged*/
+	if(((shadow->valid & ((uint32_t)1 << address)) != 0) && (shadow->words[address] == value))
+		return NOERROR;
+
+	shadow->words[address] = value;
+	shadow->valid |= (uint32_t)1 << address;
+	shadow->dirty |= (uint32_t)1 << address;
+
+	return NOERROR;
+}
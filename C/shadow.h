@@ -0,0 +1,44 @@
+#ifndef SHADOW_H__
+#define SHADOW_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define SHADOW_SIZE 0x20		//Extended SRAM addresses 0x0000:0x001F held in the shadow copy
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Host copy of the extended SRAM of a device*/
+typedef struct
+{
+	uint32_t words[SHADOW_SIZE];	//SRAM content
+	uint32_t valid;					//Bit i set if words[i] is known
+	uint32_t dirty;					//Bit i set if words[i] must be written back to the device
+} A1335shadow;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void ShadowInit(A1335shadow *shadow);
+int ShadowAttach(int cs, A1335shadow *shadow);
+void ShadowDetach(int cs);
+int ShadowLoad(int cs, uint8_t buffer[]);
+int ShadowFlush(int cs, uint8_t buffer[]);
+void ShadowInvalidate(int cs);
+int SRAMread(int cs, uint8_t buffer[], uint16_t address, uint32_t *value);
+int SRAMwrite(int cs, uint8_t buffer[], uint16_t address, uint32_t value);
+
+#endif
@@ -0,0 +1,508 @@
+/*******************************************
+
+	University of Udine
+
+	SPI transport layer for the Allegro A1335
+	library
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Every frame of the A1335 is 16 bit long and the chip select must be toggled after each frame
+	- The frames of one operation are queued and submitted with a single SPI_IOC_MESSAGE(n) ioctl,
+	  the chip select is released between frames by setting cs_change on every transfer but the last
+	- Every chip select (cs) is mapped to a device: by default cs is the hardware CE line of the
+	  spidev channel cs, SPIsetDevice() maps it to a GPIO pin instead to drive more sensors than
+	  the CE lines. The sensors on GPIO chip selects share the channel (leave its CE line
+	  unconnected) and their frames are submitted one at a time, the pin toggled around each
+	- Every device has its own SPI clock (SPIsetSpeed(), see calibrate.c), set on each transfer:
+	  sensors at different clocks share a bus. The clock is kept when cs is mapped to another
+	  device
+	- wiringPi drives the channels of bus 0 only, SPIopenDevice() maps cs to /dev/spidevB.C of any
+	  bus (opened once per bus and channel). Different buses can be used by different threads at
+	  the same time, the sensors of one bus by one thread only
+	- The counters are atomic, they add up the transfers of every thread
+	- Every transfer is timed and counted per device (see metrics.c)
+	- An optional capture function sees the frames sent and received of every transfer (see
+	  capture.c), the frames sent are copied only while it is set
+	- With the CRC framing of a chip select on (SPIsetCRC(), the sensor configured for it) every
+	  frame is 20 bit long, sent as 3 bytes: the word, then its CRC-4 in the 4 MSB of the third
+	  byte (the 4 bits left are padding). SPIsubmit() appends the CRC of the frames sent and checks
+	  the CRC of every response, whatever the transport: primary reads, extended accesses and
+	  pipelined transfers alike. A wrong CRC fails the transfer (ERROR) and is counted per device
+	- The CRC is table driven (SPIcrc(), two lookups in a 256 byte table per word), bit exact with
+	  the bit serial SPIcrcBitwise()
+	- The transport can be replaced (e.g. with SPIstubTransfer) to run the library without the bus,
+	  the counters are updated whatever transport is in use
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "angle.h"
+#include "spi.h"
+#include "metrics.h"
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+static SPItransferFunc transport = NULL;	//NULL = spidev of wiringPi
+static void *transportCtx = NULL;
+static SPIcaptureFunc captureFunc = NULL;
+static void *captureCtx = NULL;
+static atomic_uint_fast64_t transfers;
+static atomic_uint_fast64_t frames;
+static SPIdevice devices[SPI_MAX_DEVICES];
+static int devicesMapped = 0;
+static uint8_t crcMode[SPI_MAX_DEVICES];	//CRC framing of each chip select
+
+/*CRC-4 (x^4 + x + 1) of a byte for each 4 bit CRC folded into its 4 MSB: SPIcrcTable[(crc << 4) ^ byte]*/
+const uint8_t SPIcrcTable[256] =
+{
+	0x0, 0x3, 0x6, 0x5, 0xC, 0xF, 0xA, 0x9, 0xB, 0x8, 0xD, 0xE, 0x7, 0x4, 0x1, 0x2,
+	0x5, 0x6, 0x3, 0x0, 0x9, 0xA, 0xF, 0xC, 0xE, 0xD, 0x8, 0xB, 0x2, 0x1, 0x4, 0x7,
+	0xA, 0x9, 0xC, 0xF, 0x6, 0x5, 0x0, 0x3, 0x1, 0x2, 0x7, 0x4, 0xD, 0xE, 0xB, 0x8,
+	0xF, 0xC, 0x9, 0xA, 0x3, 0x0, 0x5, 0x6, 0x4, 0x7, 0x2, 0x1, 0x8, 0xB, 0xE, 0xD,
+	0x7, 0x4, 0x1, 0x2, 0xB, 0x8, 0xD, 0xE, 0xC, 0xF, 0xA, 0x9, 0x0, 0x3, 0x6, 0x5,
+	0x2, 0x1, 0x4, 0x7, 0xE, 0xD, 0x8, 0xB, 0x9, 0xA, 0xF, 0xC, 0x5, 0x6, 0x3, 0x0,
+	0xD, 0xE, 0xB, 0x8, 0x1, 0x2, 0x7, 0x4, 0x6, 0x5, 0x0, 0x3, 0xA, 0x9, 0xC, 0xF,
+	0x8, 0xB, 0xE, 0xD, 0x4, 0x7, 0x2, 0x1, 0x3, 0x0, 0x5, 0x6, 0xF, 0xC, 0x9, 0xA,
+	0xE, 0xD, 0x8, 0xB, 0x2, 0x1, 0x4, 0x7, 0x5, 0x6, 0x3, 0x0, 0x9, 0xA, 0xF, 0xC,
+	0xB, 0x8, 0xD, 0xE, 0x7, 0x4, 0x1, 0x2, 0x0, 0x3, 0x6, 0x5, 0xC, 0xF, 0xA, 0x9,
+	0x4, 0x7, 0x2, 0x1, 0x8, 0xB, 0xE, 0xD, 0xF, 0xC, 0x9, 0xA, 0x3, 0x0, 0x5, 0x6,
+	0x1, 0x2, 0x7, 0x4, 0xD, 0xE, 0xB, 0x8, 0xA, 0x9, 0xC, 0xF, 0x6, 0x5, 0x0, 0x3,
+	0x9, 0xA, 0xF, 0xC, 0x5, 0x6, 0x3, 0x0, 0x2, 0x1, 0x4, 0x7, 0xE, 0xD, 0x8, 0xB,
+	0xC, 0xF, 0xA, 0x9, 0x0, 0x3, 0x6, 0x5, 0x7, 0x4, 0x1, 0x2, 0xB, 0x8, 0xD, 0xE,
+	0x3, 0x0, 0x5, 0x6, 0xF, 0xC, 0x9, 0xA, 0x8, 0xB, 0xE, 0xD, 0x4, 0x7, 0x2, 0x1,
+	0x6, 0x5, 0x0, 0x3, 0xA, 0x9, 0xC, 0xF, 0xD, 0xE, 0xB, 0x8, 0x1, 0x2, 0x7, 0x4,
+};
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+static void mapDevices(void)
+{
+	int i;
+
+	/*Default: cs is the hardware CE line of the channel cs (the clocks are kept)*/
+	for(i = 0; i < SPI_MAX_DEVICES; i++)
+	{
+		devices[i].bus = 0;
+		devices[i].channel = i;
+		devices[i].gpio = -1;
+		devices[i].fd = -1;
+	}
+
+	devicesMapped = 1;
+}
+
+static int deviceFd(SPIdevice *device)
+{
+	return (device->fd >= 0) ? device->fd : wiringPiSPIGetFd(device->channel);
+}
+
+static int gpioTransfer(SPIdevice *device, uint8_t frames[][SPI_FRAME_SIZE], int n, uint32_t len)
+{
+	struct spi_ioc_transfer tr;
+	int i, fd = deviceFd(device);
+
+	memset(&tr, 0, sizeof(tr));
+
+	/*One frame per ioctl, the chip select pin released between frames*/
+	for(i = 0; i < n; i++)
+	{
+		tr.tx_buf = (unsigned long)frames[i];
+		tr.rx_buf = (unsigned long)frames[i];
+		tr.len = len;
+		tr.speed_hz = (device->speed != 0) ? device->speed : SPI_CLOCK;
+		tr.bits_per_word = 8;
+
+		digitalWrite(device->gpio, LOW);
+		if(ioctl(fd, SPI_IOC_MESSAGE(1), &tr) < 0)
+		{
+			digitalWrite(device->gpio, HIGH);
+			return ERROR;
+		}
+		digitalWrite(device->gpio, HIGH);
+	}
+
+	return NOERROR;
+}
+
+static int spidevTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n)
+{
+	struct spi_ioc_transfer tr[SPI_MAX_FRAMES];
+	SPIdevice *device;
+	uint32_t len, speed;
+	int i;
+
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	if(!devicesMapped)
+		mapDevices();
+	device = &devices[cs];
+
+	/*20 bit frames with the CRC (3 bytes), 16 bit frames otherwise*/
+	len = crcMode[cs] ? SPI_FRAME_SIZE : SPI_WORD_SIZE;
+	speed = (device->speed != 0) ? device->speed : SPI_CLOCK;
+
+	if(device->gpio >= 0)
+		return gpioTransfer(device, frames, n, len);
+
+	memset(tr, 0, sizeof(tr));
+
+	for(i = 0; i < n; i++)
+	{
+		tr[i].tx_buf = (unsigned long)frames[i];
+		tr[i].rx_buf = (unsigned long)frames[i];
+		tr[i].len = len;
+		tr[i].speed_hz = speed;
+		tr[i].bits_per_word = 8;
+
+		/*Release the chip select between frames, not after the last one*/
+		tr[i].cs_change = (i < n - 1) ? 1 : 0;
+	}
+
+	if(ioctl(deviceFd(device), SPI_IOC_MESSAGE(n), tr) < 0)
+		return ERROR;
+
+	return NOERROR;
+}
+
+void SPIqueueInit(SPIqueue *queue)
+{
+	queue->n = 0;
+}
+
+int SPIqueueFrame(SPIqueue *queue, uint8_t rw, uint8_t reg, uint8_t data)
+{
+	if(queue->n >= SPI_MAX_FRAMES)
+		return ERROR;
+
+	queue->frames[queue->n][0] = rw|reg;	//[15:8]
+	queue->frames[queue->n][1] = data;		//[7:0]
+	queue->frames[queue->n][2] = 0x00;		//CRC (appended by SPIsubmit())
+	queue->n++;
+
+	return NOERROR;
+}
+
+void SPIqueueResponse(SPIqueue *queue, int i, uint8_t buffer[])
+{
+	buffer[0] = queue->frames[i][0];
+	buffer[1] = queue->frames[i][1];
+}
+
+int SPIsubmit(int cs, SPIqueue *queue)
+{
+	uint8_t sent[SPI_MAX_FRAMES][SPI_FRAME_SIZE];
+	SPIcaptureFunc capture = captureFunc;
+	uint64_t start;
+	int i, crc, result, crcErrors = 0;
+
+	if(queue->n <= 0)
+		return NOERROR;
+
+	/*CRC of the frames sent*/
+	crc = (cs >= 0) && (cs < SPI_MAX_DEVICES) && crcMode[cs];
+	if(crc)
+		for(i = 0; i < queue->n; i++)
+			queue->frames[i][2] = (uint8_t)(SPIcrc(((uint16_t)queue->frames[i][0] << 8) | queue->frames[i][1]) << 4);
+
+	/*The responses overwrite the frames*/
+	if(capture != NULL)
+		memcpy(sent, queue->frames, (size_t)queue->n * SPI_FRAME_SIZE);
+
+	atomic_fetch_add_explicit(&transfers, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&frames, (uint_fast64_t)queue->n, memory_order_relaxed);
+
+	start = MetricsTime();
+
+	if(transport != NULL)
+		result = transport(cs, queue->frames, queue->n, transportCtx);
+	else
+		result = spidevTransfer(cs, queue->frames, queue->n);
+
+	/*CRC of the responses*/
+	if(crc && (result == NOERROR))
+	{
+		for(i = 0; i < queue->n; i++)
+			if((queue->frames[i][2] >> 4) != SPIcrc(((uint16_t)queue->frames[i][0] << 8) | queue->frames[i][1]))
+				crcErrors++;
+
+		if(crcErrors > 0)
+		{
+			MetricsCount(cs, METRIC_CRC, (uint64_t)crcErrors);
+			result = ERROR;
+		}
+	}
+
+	MetricsRecord(cs, METRIC_TRANSFER, start);
+	MetricsCount(cs, METRIC_TRANSFERS, 1);
+	MetricsCount(cs, METRIC_FRAMES, (uint64_t)queue->n);
+	if(result == ERROR)
+		MetricsCount(cs, METRIC_ERRORS, 1);
+
+	if(capture != NULL)
+		capture(cs, sent, queue->frames, queue->n, result, captureCtx);
+
+	return result;
+}
+
+int SPItransfer(int cs, uint8_t buffer[])
+{
+	SPIqueue queue;
+
+	/*Single frame transfer, the response overwrites the buffer*/
+	SPIqueueInit(&queue);
+	SPIqueueFrame(&queue, buffer[0], 0x00, buffer[1]);
+
+	if(SPIsubmit(cs, &queue) == ERROR)
+		return ERROR;
+
+	SPIqueueResponse(&queue, 0, buffer);
+
+	return NOERROR;
+}
+
+void SPIsetTransport(SPItransferFunc transfer, void *ctx)
+{
+	transport = transfer;
+	transportCtx = ctx;
+}
+
+void SPIsetCapture(SPIcaptureFunc capture, void *ctx)
+{
+	captureCtx = ctx;
+	captureFunc = capture;
+}
+
+int SPIsetDevice(int cs, int channel, int gpio)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	if(!devicesMapped)
+		mapDevices();
+
+	devices[cs].bus = 0;
+	devices[cs].channel = channel;
+	devices[cs].gpio = gpio;
+	devices[cs].fd = -1;
+
+	/*Chip select released*/
+	if(gpio >= 0)
+	{
+		pinMode(gpio, OUTPUT);
+		digitalWrite(gpio, HIGH);
+	}
+
+	return NOERROR;
+}
+
+static int openSpidev(int bus, int channel)
+{
+	char path[32];
+	uint8_t mode = MODE, bits = 8;
+	uint32_t speed = SPI_CLOCK;
+	int i, fd;
+
+	/*Already open for another chip select*/
+	for(i = 0; i < SPI_MAX_DEVICES; i++)
+		if((devices[i].fd >= 0) && (devices[i].bus == bus) && (devices[i].channel == channel))
+			return devices[i].fd;
+
+	snprintf(path, sizeof(path), "/dev/spidev%d.%d", bus, channel);
+	fd = open(path, O_RDWR);
+	if(fd < 0)
+		return -1;
+
+	if((ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0) || (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) ||
+	   (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int SPIopenDevice(int cs, int bus, int channel, int gpio)
+{
+	int fd;
+
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES) || (bus < 0) || (channel < 0))
+		return ERROR;
+
+	if(!devicesMapped)
+		mapDevices();
+
+	fd = openSpidev(bus, channel);
+	if(fd < 0)
+		return ERROR;
+
+	devices[cs].bus = bus;
+	devices[cs].channel = channel;
+	devices[cs].gpio = gpio;
+	devices[cs].fd = fd;
+
+	/*Chip select released*/
+	if(gpio >= 0)
+	{
+		pinMode(gpio, OUTPUT);
+		digitalWrite(gpio, HIGH);
+	}
+
+	return NOERROR;
+}
+
+void SPIcloseDevices(void)
+{
+	int i, j;
+
+	if(!devicesMapped)
+		return;
+
+	/*Every descriptor once, then back to the default mapping*/
+	for(i = 0; i < SPI_MAX_DEVICES; i++)
+	{
+		if(devices[i].fd < 0)
+			continue;
+
+		close(devices[i].fd);
+		for(j = SPI_MAX_DEVICES - 1; j > i; j--)
+			if(devices[j].fd == devices[i].fd)
+				devices[j].fd = -1;
+	}
+
+	mapDevices();
+}
+
+int SPIgetDevice(int cs, SPIdevice *device)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	if(!devicesMapped)
+		mapDevices();
+
+	*device = devices[cs];
+
+	return NOERROR;
+}
+
+int SPIsetSpeed(int cs, uint32_t speed)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	if(!devicesMapped)
+		mapDevices();
+
+	/*0 = back to SPI_CLOCK*/
+	devices[cs].speed = speed;
+
+	return NOERROR;
+}
+
+uint32_t SPIgetSpeed(int cs)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES) || !devicesMapped || (devices[cs].speed == 0))
+		return SPI_CLOCK;
+
+	return devices[cs].speed;
+}
+
+int SPIstubTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx)
+{
+	uint16_t response = 0x0001;
+	int i;
+
+	/*Bus stand-in: answer every frame with a fixed word (default 0x0001 = WDN/RDN done)*/
+	if(ctx != NULL)
+		response = *(uint16_t *)ctx;
+
+	for(i = 0; i < n; i++)
+	{
+		frames[i][0] = (uint8_t)(response >> 8);
+		frames[i][1] = (uint8_t)(response & 0x00FF);
+		frames[i][2] = (uint8_t)(SPIcrc(response) << 4);
+	}
+
+	return NOERROR;
+}
+
+int SPIsetCRC(int cs, int enable)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return ERROR;
+
+	crcMode[cs] = (enable != 0);
+
+	return NOERROR;
+}
+
+int SPIgetCRC(int cs)
+{
+	if((cs < 0) || (cs >= SPI_MAX_DEVICES))
+		return 0;
+
+	return crcMode[cs];
+}
+
+uint8_t SPIcrcBitwise(uint16_t word)
+{
+	uint8_t crc = SPI_CRC_SEED, feedback;
+	int i;
+
+	/*Reference: one bit at a time, MSB first*/
+	for(i = 15; i >= 0; i--)
+	{
+		feedback = ((crc >> 3) ^ (word >> i)) & 0x01;
+		crc = (uint8_t)((crc << 1) & 0x0F);
+		if(feedback)
+			crc ^= 0x03;
+	}
+
+	return crc;
+}
+
+void SPIgetStats(SPIstats *s)
+{
+	s->transfers = atomic_load_explicit(&transfers, memory_order_relaxed);
+	s->frames = atomic_load_explicit(&frames, memory_order_relaxed);
+}
+
+void SPIresetStats(void)
+{
+	atomic_store_explicit(&transfers, 0, memory_order_relaxed);
+	atomic_store_explicit(&frames, 0, memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#ifndef SPI_H__
+#define SPI_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define SPI_WORD_SIZE 2			//2 bytes per word [15:0]
+#define SPI_FRAME_SIZE 3		//Bytes per frame: word [15:0], CRC in the 4 MSB of the third byte (CRC framing only)
+#define SPI_CRC_SEED 0x0F		//CRC-4 x^4 + x + 1, seed 1111, over the 16 bits of the word
+#define SPI_MAX_FRAMES 32		//Max number of frames queued for a single transfer
+#define SPI_MAX_DEVICES 32		//Max number of chip selects
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Frames of one operation, submitted to the bus in a single transfer (chip select toggled after each frame)*/
+typedef struct
+{
+	uint8_t frames[SPI_MAX_FRAMES][SPI_FRAME_SIZE];
+	int n;
+} SPIqueue;
+
+/*Transport function: full duplex exchange of n frames, responses overwrite the frames*/
+typedef int (*SPItransferFunc)(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx);
+
+/*Capture function: called after every transfer with the frames sent and received*/
+typedef void (*SPIcaptureFunc)(int cs, const uint8_t sent[][SPI_FRAME_SIZE], const uint8_t received[][SPI_FRAME_SIZE], int n, int result, void *ctx);
+
+/*Chip select of a device: hardware CE line of a spidev channel or GPIO pin*/
+typedef struct
+{
+	int bus;				//SPI bus (spidevB.C)
+	int channel;			//spidev channel (wiringPiSPISetupMode() channel on bus 0) driving clock and data
+	int gpio;				//Chip select pin (BCM), -1 = hardware CE of the channel
+	int fd;					//Descriptor opened by SPIopenDevice(), -1 = wiringPi channel
+	uint32_t speed;			//SPI clock of the device (in Hz, SPIsetSpeed()), 0 = SPI_CLOCK
+} SPIdevice;
+
+/*Bus counters*/
+typedef struct
+{
+	uint64_t transfers;		//Number of transfers submitted to the bus
+	uint64_t frames;		//Number of frames exchanged
+} SPIstats;
+
+/*******************************************
+
+	Variables:
+
+*******************************************/
+
+extern const uint8_t SPIcrcTable[256];
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void SPIqueueInit(SPIqueue *queue);
+int SPIqueueFrame(SPIqueue *queue, uint8_t rw, uint8_t reg, uint8_t data);
+void SPIqueueResponse(SPIqueue *queue, int i, uint8_t buffer[]);
+int SPIsubmit(int cs, SPIqueue *queue);
+int SPItransfer(int cs, uint8_t buffer[]);
+void SPIsetTransport(SPItransferFunc transfer, void *ctx);
+void SPIsetCapture(SPIcaptureFunc capture, void *ctx);
+int SPIsetDevice(int cs, int channel, int gpio);
+int SPIopenDevice(int cs, int bus, int channel, int gpio);
+void SPIcloseDevices(void);
+int SPIgetDevice(int cs, SPIdevice *device);
+int SPIsetSpeed(int cs, uint32_t speed);
+uint32_t SPIgetSpeed(int cs);
+int SPIstubTransfer(int cs, uint8_t frames[][SPI_FRAME_SIZE], int n, void *ctx);
+int SPIsetCRC(int cs, int enable);
+int SPIgetCRC(int cs);
+uint8_t SPIcrcBitwise(uint16_t word);
+void SPIgetStats(SPIstats *stats);
+void SPIresetStats(void);
+
+/*CRC-4 of a word: one table lookup per byte (the 4 bit CRC of the first byte folded into the second)*/
+static inline uint8_t SPIcrc(uint16_t word)
+{
+	return SPIcrcTable[(SPIcrcTable[(SPI_CRC_SEED << 4) ^ (word >> 8)] << 4) ^ (word & 0x00FF)];
+}
+
+#endif
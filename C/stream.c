@@ -0,0 +1,109 @@
+/*******************************************
+
+	University of Udine
+
+	Pipelined primary register reading for
+	the Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The A1335 answers each frame with the result of the previous command, so a single register read
+	  costs two equal Read commands (see ReadRegister())
+	- In a stream the second frame of read N is the first frame of read N+1: after the first (priming)
+	  frame every frame returns one sample, halving the frames per sample in continuous acquisition
+	- Any other access to the same chip select breaks the pipeline, call StreamReset() after it
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "angle.h"
+#include "spi.h"
+#include "stream.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+int StreamInit(A1335stream *stream, int cs, const uint8_t regs[], int n)
+{
+	int i;
+
+	if((n <= 0) || (n > STREAM_MAX_REGISTERS))
+		return ERROR;
+
+	stream->cs = cs;
+	stream->n = n;
+
+	for(i = 0; i < n; i++)
+		stream->regs[i] = regs[i];
+
+	StreamReset(stream);
+
+	return NOERROR;
+}
+
+void StreamReset(A1335stream *stream)
+{
+	stream->next = 0;
+	stream->primed = 0;
+}
+
+int StreamNext(A1335stream *stream, uint8_t *reg, uint16_t *word)
+{
+	return StreamRead(stream, reg, word, 1);
+}
+
+int StreamRead(A1335stream *stream, uint8_t reg[], uint16_t word[], int count)
+{
+	SPIqueue queue;
+	int first, i, k;
+
+	if((count <= 0) || (count > SPI_MAX_FRAMES - 1))
+		return ERROR;
+
+	SPIqueueInit(&queue);
+
+	/*Send the Read command of the first register if nothing is in flight (its response is discarded)*/
+	first = stream->primed ? 0 : 1;
+	if(first)
+		SPIqueueFrame(&queue, R, stream->regs[stream->next], 0x00);
+
+	/*Each frame sends the command of the following register and returns the register in flight*/
+	for(i = 0; i < count; i++)
+		SPIqueueFrame(&queue, R, stream->regs[(stream->next + i + 1) % stream->n], 0x00);
+
+	if(SPIsubmit(stream->cs, &queue) == ERROR)
+	{
+		StreamReset(stream);
+		return ERROR;
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		k = first + i;
+		reg[i] = stream->regs[stream->next];
+		word[i] = ((uint16_t)queue.frames[k][0] << 8) + (uint16_t)queue.frames[k][1];
+		stream->next = (stream->next + 1) % stream->n;
+	}
+
+	stream->primed = 1;
+
+	return NOERROR;
+}
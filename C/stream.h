@@ -0,0 +1,42 @@
+#ifndef STREAM_H__
+#define STREAM_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define STREAM_MAX_REGISTERS 8		//Max number of primary registers in a stream sequence
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Pipelined reading of a sequence of primary registers (the response of each frame is the previous command result)*/
+typedef struct
+{
+	int cs;
+	uint8_t regs[STREAM_MAX_REGISTERS];		//Sequence of primary registers (even addresses, e.g. 0x20, 0x28, 0x2A)
+	int n;									//Number of registers in the sequence
+	int next;								//Index of the register whose Read command is in flight
+	int primed;								//1 if a Read command is in flight
+} A1335stream;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+int StreamInit(A1335stream *stream, int cs, const uint8_t regs[], int n);
+void StreamReset(A1335stream *stream);
+int StreamNext(A1335stream *stream, uint8_t *reg, uint16_t *word);
+int StreamRead(A1335stream *stream, uint8_t reg[], uint16_t word[], int count);
+
+#endif
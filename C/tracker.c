@@ -0,0 +1,227 @@
+/*******************************************
+
+	University of Udine
+
+	Refresh synchronized polling of the
+	Allegro A1335
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- Each sensor is polled on the cadence of its own refresh (ORATE) instead of a fixed period:
+	  the new angle flag (NF, bit 13 of the angle register, cleared by the reading) tells a new
+	  angle from a duplicate
+	- Searching the phase the sensor is polled every refresh time / TRACKER_STEPS, an update
+	  read right after a stale reading is bracketed and the tracker locks
+	- Locked, the first poll of a refresh is half a step after the expected update: usually the
+	  angle is new (one reading per refresh), else the poll is repeated every step. The expected
+	  update is corrected by the bracketed updates and nudged earlier by the others, the refresh
+	  time is measured (the sensor clock is not the host clock) within TRACKER_TOLERANCE
+	- The age of the angles when read is about half a step, TrackerAge() reports the mean
+	- TrackerRun() polls many sensors, each when its update is due: the bus time is spent on
+	  new angles only and left free in between
+	- In snapshot mode every poll is a single getSnapshot() (5 frames): NF and parity come from
+	  its angle word, so no update is consumed by a second reading of 0x20
+	- A reading with a parity error is published with PARITYERROR, does not move the phase and is
+	  not a new angle (sequence and TrackerAge() unchanged), it is counted in parity
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "angle.h"
+#include "tracker.h"
+
+/*******************************************
+
+	Functions:
+
+*******************************************/
+
+void TrackerInit(A1335tracker *tracker, int cs, uint8_t orate)
+{
+	memset(tracker, 0, sizeof(A1335tracker));
+
+	tracker->cs = cs;
+	tracker->snapshot = 0;
+	tracker->locked = 0;
+	tracker->nominal = (uint64_t)ORATE_SAMPLE * 1000ULL << orate;
+	tracker->period = tracker->nominal;
+	tracker->step = tracker->nominal / TRACKER_STEPS;
+	if(tracker->step < TRACKER_MIN_STEP)
+		tracker->step = TRACKER_MIN_STEP;
+
+	tracker->next = AcquisitionTime();
+	tracker->target = tracker->next;
+}
+
+static void trackPhase(A1335tracker *tracker, uint64_t now, uint64_t update, int bracketed)
+{
+	int64_t error, limit;
+
+	if(!tracker->locked)
+	{
+		/*Searching: lock on the first bracketed update*/
+		if(!bracketed)
+		{
+			tracker->next = now + tracker->step;
+			return;
+		}
+
+		tracker->locked = 1;
+		tracker->target = update + tracker->period;
+	}
+	else
+	{
+		error = (int64_t)(update - tracker->target);
+
+		/*Phase and refresh time corrections*/
+		tracker->target += tracker->period + error / 2;
+		tracker->period += error / 16;
+
+		limit = (int64_t)tracker->nominal * TRACKER_TOLERANCE / 100;
+		if((int64_t)(tracker->period - tracker->nominal) > limit)
+			tracker->period = tracker->nominal + limit;
+		else if((int64_t)(tracker->nominal - tracker->period) > limit)
+			tracker->period = tracker->nominal - limit;
+	}
+
+	/*Updates already over (e.g. the host was late)*/
+	while((int64_t)(tracker->target + tracker->step / 2 - now) <= 0)
+		tracker->target += tracker->period;
+
+	tracker->next = tracker->target + tracker->step / 2;
+}
+
+int TrackerPoll(A1335tracker *tracker, uint8_t buffer[], A1335sample *sample)
+{
+	uint64_t now, update;
+	uint16_t word, count;
+	int bracketed, result;
+
+	now = AcquisitionTime();
+
+	memset(sample, 0, sizeof(A1335sample));
+	sample->cs = tracker->cs;
+	sample->timestamp = now;
+
+	/*Angle alone, or with status, temperature and field in the same transfer (one reading of NF)*/
+	if(tracker->snapshot)
+		result = getSnapshot(tracker->cs, buffer, &sample->snapshot);
+	else if((result = ReadRegister(tracker->cs, buffer, 0x20)) != ERROR)
+	{
+		sample->snapshot.angleWord = ((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1];
+		sample->snapshot.angle = decodeAngle(sample->snapshot.angleWord);
+	}
+
+	/*Failed transfer: nothing read, the sample stays cleared*/
+	if(result == ERROR)
+	{
+		sample->error = ERROR;
+		tracker->next = now + tracker->step;
+		return ERROR;
+	}
+
+	tracker->polls++;
+	word = sample->snapshot.angleWord;
+
+	/*Parity error: not a new angle (sequence unchanged), counted apart*/
+	if(decodeAngleCount(word, &count) != NOERROR)
+	{
+		tracker->parity++;
+		sample->sequence = tracker->sequence;
+		sample->error = PARITYERROR;
+		tracker->next = now + tracker->step;
+		return PARITYERROR;
+	}
+
+	/*Duplicate: poll again in a step*/
+	if((word & ANGLE_NF) == 0)
+	{
+		tracker->stale++;
+		tracker->lastStale = now;
+
+		/*Update far later than expected: search the phase again*/
+		if(tracker->locked && ((int64_t)(now - tracker->target) > (int64_t)(tracker->period / 2)))
+			tracker->locked = 0;
+
+		tracker->next = now + tracker->step;
+		return TRACKER_STALE;
+	}
+
+	/*New angle: bracketed if the previous reading was stale (the update is between the two)*/
+	bracketed = (tracker->lastStale != 0) && ((int64_t)(tracker->lastStale - tracker->lastFresh) > 0);
+	if(bracketed)
+		update = tracker->lastStale + (now - tracker->lastStale) / 2;
+	else if(tracker->locked)
+		update = (((int64_t)(now - tracker->target) < 0) ? now : tracker->target) - tracker->step / 4;
+	else
+		update = now - tracker->period / 2;
+
+	tracker->lastFresh = now;
+	tracker->ageSum += (double)(now - update);
+	trackPhase(tracker, now, update, bracketed);
+
+	sample->sequence = tracker->sequence++;
+	sample->error = NOERROR;
+
+	return NOERROR;
+}
+
+int TrackerNext(A1335tracker trackers[], int n)
+{
+	int i, first = 0;
+
+	for(i = 1; i < n; i++)
+		if((int64_t)(trackers[i].next - trackers[first].next) < 0)
+			first = i;
+
+	return first;
+}
+
+void TrackerRun(A1335tracker trackers[], int n, AcquisitionPublish publish, void *ctx, atomic_int *running)
+{
+	uint8_t buffer[BUFFER_SIZE];
+	struct timespec wake;
+	A1335sample sample;
+	int i, result;
+
+	while(atomic_load_explicit(running, memory_order_relaxed))
+	{
+		/*Sleep until the next sensor is due*/
+		i = TrackerNext(trackers, n);
+		wake.tv_sec = trackers[i].next / 1000000000ULL;
+		wake.tv_nsec = trackers[i].next % 1000000000ULL;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+
+		result = TrackerPoll(&trackers[i], buffer, &sample);
+
+		if(((result == NOERROR) || (result == PARITYERROR)) && (publish != NULL))
+			publish(&sample, ctx);
+	}
+}
+
+double TrackerAge(A1335tracker *tracker)
+{
+	if(tracker->sequence == 0)
+		return 0.0;
+
+	return tracker->ageSum / (double)tracker->sequence;
+}
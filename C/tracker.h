@@ -0,0 +1,63 @@
+#ifndef TRACKER_H__
+#define TRACKER_H__
+
+/*stdint.h has the definitions of int8_t, int16_t, ...*/
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample.h"
+#include "acquisition.h"
+
+/*******************************************
+
+	Definitions:
+
+*******************************************/
+
+#define TRACKER_STALE -3			//No new angle since the last reading
+#define TRACKER_STEPS 8				//Polls per refresh time while searching the phase
+#define TRACKER_MIN_STEP 20000		//Min time between two polls of a sensor (in ns)
+#define TRACKER_TOLERANCE 10		//Max deviation of the refresh time from the nominal one (in %)
+
+/*******************************************
+
+	Types:
+
+*******************************************/
+
+/*Phase of the refresh of a sensor*/
+typedef struct
+{
+	int cs;
+	int snapshot;			//1 to read status, temperature and field with the angle (getSnapshot() at every poll)
+
+	/*Phase tracking (times in ns, CLOCK_MONOTONIC)*/
+	int locked;				//1 once an update has been bracketed between a stale and a new reading
+	uint64_t nominal;		//Nominal refresh time of the ORATE
+	uint64_t period;		//Refresh time measured
+	uint64_t step;			//Time between two polls waiting for an update
+	uint64_t target;		//Expected time of the next update
+	uint64_t next;			//Time of the next poll
+	uint64_t lastStale;		//Time of the last stale reading
+	uint64_t lastFresh;		//Time of the last new angle read
+	uint64_t sequence;		//Number of new angles read
+
+	/*Statistics*/
+	uint64_t polls;			//Readings of the angle register
+	uint64_t stale;			//Readings without a new angle
+	uint64_t parity;		//Readings with a parity error
+	double ageSum;			//Sum of the estimated ages of the new angles when read (in ns)
+} A1335tracker;
+
+/*******************************************
+
+	Prototypes:
+
+*******************************************/
+
+void TrackerInit(A1335tracker *tracker, int cs, uint8_t orate);
+int TrackerPoll(A1335tracker *tracker, uint8_t buffer[], A1335sample *sample);
+int TrackerNext(A1335tracker trackers[], int n);
+void TrackerRun(A1335tracker trackers[], int n, AcquisitionPublish publish, void *ctx, atomic_int *running);
+double TrackerAge(A1335tracker *tracker);
+
+#endif
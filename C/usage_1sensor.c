@@ -11,7 +11,7 @@
 	- WiringPi library
 
 	Compiling:
-	cc -o reading main.c angle.c -lwiringPi
+	cc -o reading main.c angle.c spi.c metrics.c shadow.c acquisition.c ring.c estimator.c rate.c -lwiringPi -lpthread -lm
 	
 	Notes:
 	File angles.txt must be placed into the angles
@@ -37,6 +37,8 @@
 #include <string.h>
 #include <errno.h>
 #include "angle.h"
+#include "acquisition.h"
+#include "ring.h"
 
 /*******************************************************
 
@@ -44,12 +46,18 @@
 
 *******************************************************/
 
+/*Ring between the acquisition thread and the reading loop*/
+static A1335ring ring;
+
 int main(int argc, char *argv[])
 {
 	uint8_t buffer[BUFFER_SIZE];	//buffer [15:0]
-	float angle, tempAngle = 0;				//Angle value
-	float temp = 0;					//Temperature value
-	float field = 0;				//Field value
+	A1335acquisition acq;			//Acquisition thread
+	A1335sample samples[64];		//Samples popped from the ring
+	int cs[1] = {0};
+	size_t n, k;
+	float angle;				//Angle value
+	float angles[SL_COEFFICIENTS];	//Segmented Linearization coefficients
 	char ch;
 	char str[50];
 	int i = 0;
@@ -186,45 +194,69 @@ int main(int argc, char *argv[])
 					return 1;
 				}
 				
-				i = 1;
+				i = 0;
 					
 				while(fgets(str, 100, fp) != NULL)
 				{
 					strtok(str, "\n");			//don't work if a line is just \n
-					tempAngle = atof(str);
-						
-					if(SetSLCoefficients(0, buffer, tempAngle, i) == NOERROR)
-						printf("\nSetup SL Coefficient done\n");
-					else
-					{
-						printf("\nSetup SL Coefficient ERROR\n");
-						return 1 ;
-					}
-						
-					i++;
 						
-					if(i > 16)
+					if(i >= SL_COEFFICIENTS)
 					{
 						printf("\nSetup SL Coefficient ERROR\n");
 						return 1 ;
 					}
+
+					angles[i++] = atof(str);
+				}
+
+				/*Write all the coefficients at once*/
+				if(i == SL_COEFFICIENTS && SetSLCoefficientsBulk(0, buffer, angles) == NOERROR)
+					printf("\nSetup SL Coefficients done\n");
+				else
+				{
+					printf("\nSetup SL Coefficients ERROR\n");
+					return 1 ;
 				}
 					
 				fclose(fp);
 			}
 		
+			/*The acquisition thread reads the sensor every delay ms and pushes the samples into the ring*/
+			if((atoi(argv[2]) <= 0) || (AcquisitionInit(&acq, cs, 1, (uint64_t)atoi(argv[2]) * 1000000ULL) == ERROR) || (RingInit(&ring, 1024, RING_DROP_OLDEST) == ERROR))
+			{
+				printf("\nAcquisition setup ERROR\n");
+				return 1;
+			}
+			acq.publish = RingPublish;
+			acq.publishCtx = &ring;
+			
 			printf("\nStart angle reading loop...\n\n");
+			if(AcquisitionStart(&acq) == ERROR)
+			{
+				printf("\nAcquisition start ERROR\n");
+				return 1;
+			}
+			
 			while(1)
 			{
 				delay(atoi(argv[2]));
-				if((angle = getAngle(0, buffer)) != (float)ERROR)
-					printf("Angle: %f\n", angle);
-				else
-					printf("Angle reading ERROR\n");
-				temp = getTemp(0, buffer);
-				printf("Temp: %f\n", temp);
-				field = getField(0, buffer);
-				printf("Field: %f\n\n", field);				
+				
+				/*Drain every sample queued meanwhile*/
+				while((n = RingPopBatch(&ring, samples, 64)) > 0)
+				{
+					for(k = 0; k < n; k++)
+					{
+						if(samples[k].error == NOERROR)
+						{
+							printf("Angle: %f\n", samples[k].snapshot.angle);
+							printf("Temp: %f\n", samples[k].snapshot.temp);
+							printf("Field: %f\n", samples[k].snapshot.field);
+						}
+						else
+							printf("Angle reading ERROR\n");
+						printf("Position: %f (turn %d), Velocity: %f\n\n", samples[k].estimate.position, samples[k].estimate.turns, samples[k].estimate.velocity);
+					}
+				}
 			}
 		}
 		else
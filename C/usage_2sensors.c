@@ -11,7 +11,7 @@
 	- WiringPi library
 
 	Compiling:
-	cc -o reading main.c angle.c -lwiringPi
+	cc -o reading main.c angle.c spi.c metrics.c shadow.c bringup.c -lwiringPi
 	
 	Notes:
 	File anglesX.txt (where X indicates the number
@@ -38,6 +38,7 @@
 #include <string.h>
 #include <errno.h>
 #include "angle.h"
+#include "bringup.h"
 
 /*******************************************************
 
@@ -48,9 +49,12 @@
 int main(int argc, char *argv[])
 {
 	uint8_t buffer[BUFFER_SIZE];	//buffer [15:0]
-	float angle, tempAngle = 0;		//Angle value
-	float temp = 0;					//Temperature value
-	float field = 0;				//Field value
+	float angle;		//Angle value
+	float angles[SL_COEFFICIENTS];	//Segmented Linearization coefficients
+	A1335snapshot snapshot[2];		//Angle, temperature and field values
+	int result[2];					//Result of the readings
+	A1335bringup sensors[2];		//Bring-up state of the devices
+	int options = 0;				//Bring-up options
 	char ch;
 	char str[50];
 	int i, j;
@@ -87,178 +91,155 @@ int main(int argc, char *argv[])
 	printf("\nDo you want to make a reset? (S = Soft Reset | H = Hard Reset | N = No): ");
 	scanf("%c", &ch);
 	if(ch == 's' || tolower(ch) == 's')
-	{
-		printf("\nSoft Reset...");
-		delay(500);
-		SoftReset(0, buffer);
-		SoftReset(1, buffer);
-		printf("\nSoft Reset done\n");
-	}
+		options |= BRINGUP_SOFTRESET;
 	else if(ch == 'h' || tolower(ch) == 'h')
-	{
-		printf("\nHard Reset...");
-		delay(500);
-		HardReset(0, buffer);
-		HardReset(1, buffer);
-		printf("\nHard Reset done\n");
-	}
+		options |= BRINGUP_HARDRESET;
 	
 	/*Cleaning input buffer*/
 	while((getchar()) != '\n');
 
-	if(checkSelfTest(0, buffer) == NOERROR && checkSelfTest(1, buffer) == NOERROR)
+	if(strcmp(argv[1], "1") == 0)
+		options |= BRINGUP_EEPROM;
+
+	/*Poll the readiness bits of the devices instead of waiting the worst case settle times*/
+	options |= BRINGUP_FASTBOOT;
+
+	/*Reset, self test, unlock, EEPROM and SRAM setup of both devices together (settle times overlap)*/
+	printf("\nSetup devices...");
+	BringUpInit(&sensors[0], 0);
+	BringUpInit(&sensors[1], 1);
+
+	if(BringUp(sensors, 2, options) == ERROR)
+	{
+		for(j = 0; j < 2; j++)
+			if(sensors[j].result == ERROR)
+				printf("\n%s ERROR (device %d)\n", BringUpStepName(sensors[j].step), j + 1);
+		return 1;
+	}
+
+	printf("\nSetup devices done\n");
+	for(j = 0; j < 2; j++)
+		printf("Time to first valid sample device %d (cs%d): %u us\n", j + 1, j, sensors[j].firstSample);
+
+	printf("\nDo you want to start the Segmented Linearization Coefficients setup? (Y = Yes | N = No | R = Read from file): ");
+	scanf("%c", &ch);
+	if(ch == 'y' || tolower(ch) == 'y')
 	{
-		printf("\nUnlocking device...");
-		delay(500);
-		if(UnlockDevice(0, buffer) == NOERROR && UnlockDevice(1, buffer) == NOERROR)
+		/*Cleaning input buffer*/
+		while((getchar()) != '\n');
+
+		for(j = 1; j <= 2; j++)
 		{
-			printf("\nDevice Unlocked\n");
-			if(strcmp(argv[1], "1") == 0)
-			{
-				printf("\nSetup EEPROM...");
+			
+			strcpy(str,  "angles\anglesX.txt");
+			str[13] = j+ '0';
+			
+			fp = fopen(str, "a");
+			
+			if (fp == NULL) 
+			{   
+				printf("Error! Could not open file\n"); 
+				return 1;
+			} 
+			
+			printf("\nSetup SL Coefficients of device %d ...", j);
+			delay(500);
+			/*Set the Linearization Coefficient*/
+			for(i = 1; i <= 15; i++)
+			{						
+				printf("\nTurn magnet of 22.5 degrees and after that press any key for getting angle ");
+				getchar();
+
+				/*Get the current angle*/
+				printf("\nMeasuring the angle...\n\n");
+				delay(500);
+				
+				if((angle = getAngle((j-1), buffer)) == (float)ERROR)
+					printf("Angle reading ERROR\n");
+				
 				delay(500);
-				if(EEPROMSetup(0, buffer) == NOERROR && EEPROMSetup(1, buffer) == NOERROR)
-					printf("\nSetup EEPROM done\n");
+				
+				fprintf(fp, "%f\n", angle);
+				
+				if(SetSLCoefficients((j-1), buffer, angle, i) == NOERROR)
+					printf("\nSetup SL Coefficient done\n");
 				else
 				{
-					printf("\nSetup EEPROM ERROR\n");
+					printf("\nSetup SL Coefficient ERROR\n");
 					return 1 ;
 				}
 			}
-			printf("\nSetup SRAM...");
-			delay(500);
-			if(SRAMsetup(0, buffer) == NOERROR && SRAMsetup(1, buffer) == NOERROR)
-					printf("\nSetup SRAM done\n");
-				else
+		fclose(fp);
+		}
+	}
+	else if(ch == 'r' || tolower(ch) == 'r')
+	{
+		for(j = 1; j <= 2; j++)
+		{
+			strcpy(str,  "angles\anglesX.txt");
+			str[13] = j+ '0';
+			
+			fp = fopen(str, "r");
+				
+			if (fp == NULL) 
+			{   
+				printf("Error! Could not open file\n"); 
+				return 1;
+			} 
+			
+			i = 0;
+			
+			while(fgets(str, 100, fp) != NULL)
+			{
+				strtok(str, "\n");			//don't work if a line is just \n
+				
+				if(i >= SL_COEFFICIENTS)
 				{
-					printf("\nSetup SRAM ERROR\n");
+					printf("\nSetup SL Coefficient ERROR\n");
 					return 1 ;
 				}
-			printf("\nDo you want to start the Segmented Linearization Coefficients setup? (Y = Yes | N = No | R = Read from file): ");
-			scanf("%c", &ch);
-			if(ch == 'y' || tolower(ch) == 'y')
-			{
-				/*Cleaning input buffer*/
-					while((getchar()) != '\n');
 
-				for(j = 1; j <= 2; j++)
-				{
-					
-					strcpy(str,  "angles\anglesX.txt");
-					str[13] = j+ '0';
-					
-					fp = fopen(str, "a");
-					
-					if (fp == NULL) 
-					{   
-						printf("Error! Could not open file\n"); 
-						return 1;
-					} 
-					
-					printf("\nSetup SL Coefficients of device %d ...", j);
-					delay(500);
-					/*Set the Linearization Coefficient*/
-					for(i = 1; i <= 15; i++)
-					{						
-						printf("\nTurn magnet of 22.5 degrees and after that press any key for getting angle ");
-						getchar();
-
-						/*Get the current angle*/
-						printf("\nMeasuring the angle...\n\n");
-						delay(500);
-						
-						if((angle = getAngle((j-1), buffer)) == (float)ERROR)
-							printf("Angle reading ERROR\n");
-						
-						delay(500);
-						
-						fprintf(fp, "%f\n", angle);
-						
-						if(SetSLCoefficients((j-1), buffer, angle, i) == NOERROR)
-							printf("\nSetup SL Coefficient done\n");
-						else
-						{
-							printf("\nSetup SL Coefficient ERROR\n");
-							return 1 ;
-						}
-					}
-				fclose(fp);
-				}
+				angles[i++] = atof(str);
 			}
-			else if(ch == 'r' || tolower(ch) == 'r')
-			{
-				for(j = 1; j <= 2; j++)
-				{
-					strcpy(str,  "angles\anglesX.txt");
-					str[13] = j+ '0';
-					
-					fp = fopen(str, "r");
-						
-					if (fp == NULL) 
-					{   
-						printf("Error! Could not open file\n"); 
-						return 1;
-					} 
-					
-					i = 1;
-					
-					while(fgets(str, 100, fp) != NULL)
-					{
-						strtok(str, "\n");			//don't work if a line is just \n
-						tempAngle = atof(str);
-						
-						if(SetSLCoefficients((j-1), buffer, tempAngle, i) == NOERROR)
-							printf("\nSetup SL Coefficient done\n");
-						else
-						{
-							printf("\nSetup SL Coefficient ERROR\n");
-							return 1 ;
-						}
-						
-						i++;
-						
-						if(i > 16)
-						{
-							printf("\nSetup SL Coefficient ERROR\n");
-							return 1 ;
-						}
-					}
-					
-					fclose(fp);	
-				}
-			}
-			printf("\nStart angle reading loop...\n\n");
-			while(1)
+
+			/*Write all the coefficients at once*/
+			if(i == SL_COEFFICIENTS && SetSLCoefficientsBulk((j-1), buffer, angles) == NOERROR)
+				printf("\nSetup SL Coefficients of device %d done\n", j);
+			else
 			{
-				delay(atoi(argv[2]));
-				if((angle = getAngle(0, buffer)) != (float)ERROR)
-					printf("Angle device 1 (cs0): %f\n", angle);
-				else
-					printf("Angle device 1 (cs0) reading ERROR\n");
-				if((angle = getAngle(1, buffer)) != (float)ERROR)
-					printf("Angle device 2 (cs1): %f\n", angle);
-				else
-					printf("Angle device 2 (cs1) reading ERROR\n");
-				temp = getTemp(0, buffer);
-				printf("Temp device 1 (cs0): %f\n", temp);
-				temp = getTemp(1, buffer);
-				printf("Temp device 2 (cs1): %f\n", temp);
-				field = getField(0, buffer);
-				printf("Field device 1 (cs0): %f\n", field);
-				field = getField(1, buffer);
-				printf("Field device 2 (cs1): %f\n\n", field);	
+				printf("\nSetup SL Coefficients of device %d ERROR\n", j);
+				return 1 ;
 			}
-		}
-		else
-		{
-			printf("\nUnlocking device Error\n");
-			return 1;
+			
+			fclose(fp);	
 		}
 	}
-	else
+	printf("\nStart angle reading loop...\n\n");
+	while(1)
 	{
-		printf("\nSelf test Error\n");
-		return 1;
+		delay(atoi(argv[2]));
+
+		/*Read angle, temperature and field of each device in a single burst*/
+		result[0] = getSnapshot(0, buffer, &snapshot[0]);
+		result[1] = getSnapshot(1, buffer, &snapshot[1]);
+
+		for(j = 0; j < 2; j++)
+		{
+			/*Transfer failed: nothing read*/
+			if(result[j] == ERROR)
+			{
+				printf("Device %d (cs%d) reading ERROR\n", (j+1), j);
+				continue;
+			}
+
+			if(result[j] == PARITYERROR)
+				printf("Angle device %d (cs%d) parity ERROR\n", (j+1), j);
+			else
+				printf("Angle device %d (cs%d): %f\n", (j+1), j, snapshot[j].angle);
+			printf("Temp device %d (cs%d): %f\n", (j+1), j, snapshot[j].temp);
+			printf("Field device %d (cs%d): %f\n", (j+1), j, snapshot[j].field);
+		}
+		printf("\n");
 	}
 	return 1;
 }
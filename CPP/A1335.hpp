@@ -0,0 +1,302 @@
+#ifndef A1335_HPP__
+#define A1335_HPP__
+
+/*******************************************
+
+	University of Udine
+
+	Header-only C++17 driver for the Allegro
+	A1335, specialized at compile time on a
+	configuration type
+
+	Authors:
+	- Alessandro Fornasier
+
+*******************************************/
+
+/*******************************************
+
+	NOTE:
+
+	- The configuration (the #defines of C/angle.h) is a type: register words, flags, gain and
+	  offset encodings are computed constexpr and the unused branches are discarded at compile time
+	- Drivers with different configurations can coexist in the same program
+	- The frames of the reading path are compile time constants, a reading is a straight copy of
+	  the frames into an SPIqueue and a single transfer
+	- The transport, the extended access and the zero/offset setup are the ones of the C library
+	- Short stroke angles are encoded as [31:16] max, [15:0] min and the gain offset in angle
+	  resolution units (65536 / 360 per degree)
+
+*******************************************/
+
+/*******************************************
+
+	Library:
+
+*******************************************/
+
+#include <cstdint>
+#include <limits>
+
+extern "C"
+{
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+#include "../C/angle.h"
+#include "../C/spi.h"
+#include "../C/shadow.h"
+}
+
+namespace A1335
+{
+
+/*******************************************
+
+	Configurations:
+
+*******************************************/
+
+/*Same configuration as the #defines of C/angle.h*/
+struct DefaultConfig
+{
+	static constexpr double minAngle = 0;				//Min angle (in Degrees)
+	static constexpr double maxAngle = 90;				//Max angle (in Degrees)
+	static constexpr uint32_t direction = 0;			//Direction of rotation (0 = Clockwise | 0x12 = Counterclockwise)
+	static constexpr bool shortStroke = false;			//Short Stroke Application
+	static constexpr double gainOffset = 0;				//Angle = Measured angle - gain offset (in Degrees)
+	static constexpr double gain = 0;					//Gain = (360 / (maxAngle - minAngle)) - 1
+	static constexpr bool linearization = true;			//Segmented Linearization
+	static constexpr bool internalEncoder = true;		//Encoder for linearization setup
+	static constexpr uint32_t orate = 7;				//Output rate (2^orate samples averaged)
+};
+
+/*******************************************
+
+	Encodings:
+
+*******************************************/
+
+constexpr uint8_t readCode = 0x00;		//Read Code [15:14] = 00
+constexpr uint8_t writeCode = 0x40;		//Write Code [15:14] = 01
+
+constexpr uint16_t frame(uint8_t rw, uint8_t reg, uint8_t data)
+{
+	return (uint16_t)(((uint16_t)(rw | reg) << 8) | data);
+}
+
+constexpr uint16_t angleUnits(double degrees)
+{
+	return (uint16_t)(degrees * 65536 / 360);
+}
+
+constexpr bool parity(uint16_t word)
+{
+	int cnt = 0;
+
+	for(int i = 0; i < 16; i++)
+		cnt += (word >> i) & 0x0001;
+
+	return (cnt & 0x0001) == 0x0001;
+}
+
+/*Same formulas of decodeAngle(), decodeTemp() and decodeField()*/
+constexpr float angle(uint16_t word)
+{
+	return parity(word) ? (float)((word & 0x0FFF) * 360.0 / 4096.0) : (float)ERROR;
+}
+
+constexpr float temp(uint16_t word)
+{
+	return (float)(((word & 0x0FFF) / 8.0) - 273.16);
+}
+
+constexpr float field(uint16_t word)
+{
+	return (float)(word & 0x0FFF);
+}
+
+/*******************************************
+
+	Driver:
+
+*******************************************/
+
+template<typename Config>
+class Driver
+{
+public:
+	/*SRAM address 0x06 flags (Segmented Linearization, Short Stroke, Direction, Encoder)*/
+	static constexpr uint32_t flags = 0x0FFFFFFF & (((uint32_t)Config::linearization << 26) + ((uint32_t)Config::shortStroke << 24)
+		+ ((uint32_t)Config::direction << 21) + ((uint32_t)Config::internalEncoder << 20));
+
+	/*SRAM address 0x06 with the Segmented Linearization bypassed and the angle offset cleared*/
+	static constexpr uint32_t flagsBypass = (flags + 0x02000000) & 0xFFFF0000;
+
+	/*SRAM addresses 0x01:0x02 Max/Min angle and clamping (Short Stroke Application)*/
+	static constexpr uint32_t shortStrokeAngles = ((uint32_t)angleUnits(Config::maxAngle) << 16) + (uint32_t)angleUnits(Config::minAngle);
+
+	/*SRAM address 0x03 gain offset [31:16] and gain [15:0] (integer part [15:8], hundredths [7:0])*/
+	static constexpr uint32_t gainWord = ((uint32_t)angleUnits(Config::gainOffset) << 16)
+		+ (uint32_t)(((uint16_t)Config::gain << 8) + (uint16_t)(100 * (Config::gain - (uint16_t)Config::gain)));
+
+	static_assert(Config::orate <= ORATE_MAX, "ORATE out of range");
+	static_assert(!Config::shortStroke || (Config::maxAngle > Config::minAngle), "Short stroke needs maxAngle > minAngle");
+
+	explicit Driver(int cs) : cs(cs) {}
+
+	/*Same sequence of SRAMsetup() with the words computed at compile time*/
+	int setup()
+	{
+		if(SetProcessorStateToIdle(cs, buffer) == ERROR)
+			return ERROR;
+
+		if(ExtendedWrite(cs, buffer, 0xFFD0, Config::orate) == ERROR)
+			return ERROR;
+
+		if(SetProcessorStateToRun(cs, buffer) == ERROR)
+			return ERROR;
+
+		if(SRAMwrite(cs, buffer, 0x0006, flags) == ERROR)
+			return ERROR;
+
+		if constexpr(Config::shortStroke)
+		{
+			if(SRAMwrite(cs, buffer, 0x0001, shortStrokeAngles) == ERROR)
+				return ERROR;
+			if(SRAMwrite(cs, buffer, 0x0002, shortStrokeAngles) == ERROR)
+				return ERROR;
+		}
+
+		if(SRAMwrite(cs, buffer, 0x0003, gainWord) == ERROR)
+			return ERROR;
+
+		if(SRAMwrite(cs, buffer, 0x0006, flagsBypass) == ERROR)
+			return ERROR;
+
+		if(ShadowFlush(cs, buffer) == ERROR)
+			return ERROR;
+
+		delay(100);
+		if(SRAMsetZeroOffset(cs, buffer, flagsBypass) == ERROR)
+			return ERROR;
+
+		delay(100);
+		return SRAMsetPreLinearizationOffset(cs, buffer);
+	}
+
+	/*Pipelined reading of the primary registers Regs in a single transfer of N + 1 frames*/
+	template<uint8_t... Regs>
+	int read(uint16_t (&words)[sizeof...(Regs)])
+	{
+		static constexpr uint16_t frames[] = {frame(readCode, Regs, 0x00)..., lastFrame<Regs...>()};
+		SPIqueue queue;
+
+		for(int i = 0; i < (int)sizeof...(Regs) + 1; i++)
+		{
+			queue.frames[i][0] = (uint8_t)(frames[i] >> 8);
+			queue.frames[i][1] = (uint8_t)(frames[i] & 0x00FF);
+		}
+		queue.n = sizeof...(Regs) + 1;
+
+		if(SPIsubmit(cs, &queue) == ERROR)
+			return ERROR;
+
+		for(int i = 0; i < (int)sizeof...(Regs); i++)
+			words[i] = ((uint16_t)queue.frames[i + 1][0] << 8) + (uint16_t)queue.frames[i + 1][1];
+
+		return NOERROR;
+	}
+
+	/*12 bits angle count, PARITYERROR out of band*/
+	int getAngleCount(uint16_t *count)
+	{
+		uint16_t word[1];
+
+		if(read<0x20>(word) == ERROR)
+			return ERROR;
+
+		if(!parity(word[0]))
+			return PARITYERROR;
+
+		*count = word[0] & 0x0FFF;
+
+		return NOERROR;
+	}
+
+	/*Degrees in 16.16 fixed point*/
+	int getAngleQ16(uint32_t *q16)
+	{
+		uint16_t count;
+		int result;
+
+		if((result = getAngleCount(&count)) != NOERROR)
+			return result;
+
+		*q16 = (uint32_t)count * ANGLE_Q16_PER_COUNT;
+
+		return NOERROR;
+	}
+
+	float getAngle()
+	{
+		uint16_t word[1];
+
+		if(read<0x20>(word) == ERROR)
+			return (float)ERROR;
+
+		return angle(word[0]);
+	}
+
+	float getTemp()
+	{
+		uint16_t word[1];
+
+		if(read<0x28>(word) == ERROR)
+			return std::numeric_limits<float>::quiet_NaN();
+
+		return temp(word[0]);
+	}
+
+	float getField()
+	{
+		uint16_t word[1];
+
+		if(read<0x2A>(word) == ERROR)
+			return std::numeric_limits<float>::quiet_NaN();
+
+		return field(word[0]);
+	}
+
+	int getSnapshot(A1335snapshot *snapshot)
+	{
+		uint16_t word[4];
+
+		if(read<0x20, 0x22, 0x28, 0x2A>(word) == ERROR)
+			return ERROR;
+
+		snapshot->angleWord = word[0];
+		snapshot->status = word[1];
+		snapshot->tempWord = word[2];
+		snapshot->fieldWord = word[3];
+		snapshot->angle = angle(word[0]);
+		snapshot->temp = temp(word[2]);
+		snapshot->field = field(word[3]);
+
+		return parity(word[0]) ? NOERROR : PARITYERROR;
+	}
+
+private:
+	template<uint8_t... Regs>
+	static constexpr uint16_t lastFrame()
+	{
+		constexpr uint8_t regs[] = {Regs...};
+		return frame(readCode, regs[sizeof...(Regs) - 1], 0x00);
+	}
+
+	int cs;
+	uint8_t buffer[BUFFER_SIZE];
+};
+
+}
+
+#endif
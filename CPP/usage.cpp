@@ -0,0 +1,114 @@
+/*******************************************************
+
+	University of Udine
+
+	Programming two Allegro A1335 sensors with
+	different configurations (C++ driver)
+
+	Authors:
+	- Alessandro Fornasier
+
+	Requisites:
+	- WiringPi library
+	- C++17 compiler
+
+	Compiling:
+	cc -c ../C/angle.c ../C/spi.c ../C/metrics.c ../C/shadow.c
+	c++ -std=c++17 -o reading usage.cpp angle.o spi.o metrics.o shadow.o -lwiringPi
+
+*******************************************************/
+
+/*******************************************************
+
+	Library:
+
+*******************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "A1335.hpp"
+
+/*******************************************************
+
+	Configurations:
+
+*******************************************************/
+
+/*Short stroke joint (0-90 degrees), fastest output rate*/
+struct JointConfig : A1335::DefaultConfig
+{
+	static constexpr bool shortStroke = true;
+	static constexpr uint32_t orate = 0;
+};
+
+/*Full turn counterclockwise axis, default output rate*/
+struct AxisConfig : A1335::DefaultConfig
+{
+	static constexpr uint32_t direction = 0x12;
+};
+
+/*******************************************************
+
+	Main function:
+
+*******************************************************/
+
+int main(int argc, char *argv[])
+{
+	A1335::Driver<JointConfig> joint(0);	//CE0
+	A1335::Driver<AxisConfig> axis(1);		//CE1
+	A1335snapshot snapshot;
+	uint8_t buffer[BUFFER_SIZE];			//buffer [15:0]
+
+	if(argc != 2)
+	{
+		printf("USE: delay\n\n\tdelay: is the time interval for reading the angle.\n\n");
+		exit(1);
+	}
+
+	if (wiringPiSetupGpio() == -1)
+	{
+		printf("\nSetup wiringPi ERROR\n\n");
+		return 1 ;
+	}
+
+	/*Setup wiringPi SPI with CE0 and CE1 (2 slaves)*/
+	wiringPiSPISetupMode(0, SPI_CLOCK, MODE);
+	wiringPiSPISetupMode(1, SPI_CLOCK, MODE);
+
+	if(checkSelfTest(0, buffer) == ERROR || checkSelfTest(1, buffer) == ERROR)
+	{
+		printf("\nSelf test Error\n");
+		return 1;
+	}
+
+	if(UnlockDevice(0, buffer) == ERROR || UnlockDevice(1, buffer) == ERROR)
+	{
+		printf("\nUnlocking device Error\n");
+		return 1;
+	}
+
+	if(joint.setup() == ERROR || axis.setup() == ERROR)
+	{
+		printf("\nSetup SRAM ERROR\n");
+		return 1;
+	}
+
+	printf("\nStart angle reading loop...\n\n");
+	while(1)
+	{
+		delay(atoi(argv[1]));
+
+		if(joint.getSnapshot(&snapshot) == NOERROR)
+			printf("Angle joint (cs0): %f\tTemp: %f\tField: %f\n", snapshot.angle, snapshot.temp, snapshot.field);
+		else
+			printf("Angle joint (cs0) reading ERROR\n");
+
+		if(axis.getSnapshot(&snapshot) == NOERROR)
+			printf("Angle axis (cs1): %f\tTemp: %f\tField: %f\n\n", snapshot.angle, snapshot.temp, snapshot.field);
+		else
+			printf("Angle axis (cs1) reading ERROR\n\n");
+	}
+
+	return 1;
+}